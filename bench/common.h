@@ -0,0 +1,49 @@
+#pragma once
+
+#ifndef FSTL_BENCH_COMMON_H
+#define FSTL_BENCH_COMMON_H
+
+#include <benchmark/benchmark.h>
+
+#include <stdint.h>
+#include <string>
+
+// A 64-byte trivially copyable element, one cache line.
+struct payload
+{
+  uint64_t words[8];
+};
+
+// The j-th element of a benchmark, distinct for distinct j.
+template <class T>
+T make_value(size_t j);
+
+template <>
+inline uint64_t make_value<uint64_t>(size_t j) { return j * 0x9E3779B97F4A7C15ull; }
+
+// Past the small string buffer, so every string owns an allocation.
+template <>
+inline std::string make_value<std::string>(size_t j) { return "benchmark element #" + std::to_string(j); }
+
+template <>
+inline payload make_value<payload>(size_t j)
+{
+  payload p{};
+  p.words[0] = j;
+  return p;
+}
+
+// Reads an element, so that iteration benchmarks load every one.
+inline size_t touch(uint64_t value) { return value; }
+inline size_t touch(const std::string &value) { return value.size(); }
+inline size_t touch(const payload &value) { return value.words[0]; }
+
+// Element counts whose elements take about 16KB, 256KB, 4MB and 64MB: within L1, L2 and
+// the last level cache of current x86 parts, and well into DRAM.
+template <class T>
+void footprints(benchmark::internal::Benchmark *b)
+{
+  for (long bytes : {16l << 10, 256l << 10, 4l << 20, 64l << 20}) b->Arg(bytes / long(sizeof(T)));
+}
+
+#endif //FSTL_BENCH_COMMON_H
@@ -0,0 +1,220 @@
+#!/usr/bin/env python3
+"""Compile time benchmark: fstl against the standard library.
+
+Generates translation units that instantiate N distinct element types in vector,
+unordered_map and forward_list, compiles each one with and without FSTL_USE_STD_LIB, and
+records per translation unit:
+
+  frontend_s   CPU time of -fsyntax-only (parsing and template instantiation)
+  compile_s    CPU time of a full -c compile
+  object_bytes size of the object file
+  peak_rss_kb  peak resident memory of the compiler during the full compile
+
+Where the compiler supports it, the full compile also gets a breakdown: the top level
+events of clang's -ftime-trace, or the phases of gcc's -ftime-report.
+
+Results go to stdout as a table and, with --out, to a JSON file. Given the JSON of an
+earlier run with --baseline, exits with status 1 if an fstl frontend time, compile time or
+peak memory grew by more than --tolerance.
+"""
+
+import argparse
+import json
+import os
+import re
+import subprocess
+import sys
+import tempfile
+
+CONTAINERS = ("vector", "unordered_map", "forward_list")
+
+HEADERS = {
+    "vector": "fstl/vector.h",
+    "unordered_map": "fstl/unordered_map.h",
+    "forward_list": "fstl/forward_list.h",
+}
+
+# Typical use of each container with element type T, so that the member functions that
+# user code calls get instantiated.
+USES = {
+    "vector": """
+  fstl::vector<T> v;
+  v.push_back(T{{}});
+  v.emplace_back();
+  v.insert(v.begin(), T{{}});
+  v.erase(v.begin());
+  for (auto &x : v) sink(&x);
+  auto copy = v;
+  sink(&copy);
+""",
+    "unordered_map": """
+  fstl::unordered_map<int, T> m;
+  m[{index}] = T{{}};
+  m.insert({{{index} + 1, T{{}}}});
+  sink(&m.find({index})->second);
+  m.erase({index});
+  for (auto &p : m) sink(&p.second);
+  auto copy = m;
+  sink(&copy);
+""",
+    "forward_list": """
+  fstl::forward_list<T> l;
+  l.push_front(T{{}});
+  l.emplace_front();
+  for (auto &x : l) sink(&x);
+  l.pop_front();
+  auto copy = l;
+  sink(&copy);
+""",
+}
+
+
+def generate(containers, types):
+    lines = ["// Generated by bench/compile_time.py.", ""]
+    lines += ['#include "{}"'.format(HEADERS[c]) for c in containers]
+    lines += ["", "#include <string>", "", "void sink(const void *);", ""]
+    for j in range(types):
+        lines.append("struct type_{j} {{ int id = {j}; std::string name; double weight[{n}]; }};".format(
+            j=j, n=j % 4 + 1))
+    lines.append("")
+    for j in range(types):
+        lines.append("void use_{}() {{".format(j))
+        lines.append("  using T = type_{};".format(j))
+        for c in containers:
+            lines.append("  {")
+            lines.append(USES[c].format(index=j).strip("\n"))
+            lines.append("  }")
+        lines.append("}")
+    return "\n".join(lines) + "\n"
+
+
+def run(cmd):
+    """Runs `cmd`, returning (cpu seconds, peak rss in KB, stderr)."""
+    proc = subprocess.Popen(cmd, stdout=subprocess.DEVNULL, stderr=subprocess.PIPE)
+    stderr = proc.stderr.read().decode(errors="replace")
+    _, status, usage = os.wait4(proc.pid, 0)
+    proc.returncode = os.waitstatus_to_exitcode(status)
+    if proc.returncode != 0:
+        sys.exit("compile failed: {}\n{}".format(" ".join(cmd), stderr))
+    # ru_maxrss is in KB on Linux and in bytes on macOS.
+    rss = usage.ru_maxrss // 1024 if sys.platform == "darwin" else usage.ru_maxrss
+    return usage.ru_utime + usage.ru_stime, rss, stderr
+
+
+def is_clang(cxx):
+    out = subprocess.run([cxx, "--version"], capture_output=True, text=True).stdout
+    return "clang" in out
+
+
+def clang_breakdown(trace_path):
+    with open(trace_path) as f:
+        events = json.load(f)["traceEvents"]
+    totals = {}
+    for event in events:
+        name = event.get("name", "")
+        if name.startswith("Total ") and "dur" in event:
+            totals[name[len("Total "):]] = event["dur"] / 1e6
+    top = sorted(totals.items(), key=lambda kv: -kv[1])[:8]
+    return dict(top)
+
+
+def gcc_breakdown(report):
+    # " phase parsing   :   0.33 ( 54%)   0.18 ( 75%)   0.51 ( 59%)    23M ( 69%)": user, sys
+    # and wall seconds, then memory. Kept as CPU seconds, like the totals.
+    phases = {}
+    for line in report.splitlines():
+        match = re.match(r"\s*(phase [^:]+?)\s*:\s*([\d.]+)\s*\(\s*\d+%\)\s*([\d.]+)", line)
+        if match:
+            phases[match.group(1)] = round(float(match.group(2)) + float(match.group(3)), 3)
+    return phases
+
+
+def measure(args, source, mode, workdir, clang):
+    flags = [args.cxx, "-std=c++17", "-I", args.include] + args.flag
+    if mode == "std":
+        flags.append("-DFSTL_USE_STD_LIB")
+    obj = os.path.join(workdir, os.path.basename(source) + "." + mode + ".o")
+
+    frontend = min(run(flags + ["-fsyntax-only", source])[0] for _ in range(args.repeat))
+    best = None
+    for _ in range(args.repeat):
+        cpu, rss, stderr = run(flags + ["-c", source, "-o", obj])
+        if best is None or cpu < best[0]:
+            best = (cpu, rss, stderr)
+    result = {
+        "frontend_s": round(frontend, 3),
+        "compile_s": round(best[0], 3),
+        "object_bytes": os.path.getsize(obj),
+        "peak_rss_kb": best[1],
+    }
+
+    if clang:
+        run(flags + ["-ftime-trace", "-c", source, "-o", obj])
+        result["breakdown"] = clang_breakdown(os.path.splitext(obj)[0] + ".json")
+    else:
+        _, _, report = run(flags + ["-ftime-report", "-c", source, "-o", obj])
+        result["breakdown"] = gcc_breakdown(report)
+    return result
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("--cxx", default=os.environ.get("CXX", "c++"), help="compiler (default: $CXX or c++)")
+    parser.add_argument("--include", default=os.path.join(os.path.dirname(__file__), "..", "include"),
+                        help="fstl include directory")
+    parser.add_argument("--types", type=int, default=50, help="distinct element types per translation unit")
+    parser.add_argument("--repeat", type=int, default=3, help="runs per measurement; the fastest is kept")
+    parser.add_argument("--flag", action="append", default=["-O2"],
+                        help="extra compiler flag, may be repeated (default: -O2)")
+    parser.add_argument("--out", help="write the results as JSON to this file")
+    parser.add_argument("--keep", help="write the generated sources to this directory")
+    parser.add_argument("--baseline", help="JSON of an earlier run to check the fstl results against")
+    parser.add_argument("--tolerance", type=float, default=0.10,
+                        help="relative growth over the baseline that counts as a regression (default: 0.10)")
+    args = parser.parse_args()
+
+    clang = is_clang(args.cxx)
+    units = [(c, (c,)) for c in CONTAINERS] + [("all", CONTAINERS)]
+    results = {"compiler": args.cxx, "types": args.types, "flags": args.flag, "units": {}}
+
+    with tempfile.TemporaryDirectory() as workdir:
+        srcdir = args.keep or workdir
+        os.makedirs(srcdir, exist_ok=True)
+        print("{:<15} {:<5} {:>10} {:>10} {:>12} {:>12}".format(
+            "unit", "mode", "frontend", "compile", "object", "peak rss"))
+        for name, containers in units:
+            source = os.path.join(srcdir, "compile_time_{}.cpp".format(name))
+            with open(source, "w") as f:
+                f.write(generate(containers, args.types))
+            results["units"][name] = {}
+            for mode in ("fstl", "std"):
+                r = measure(args, source, mode, workdir, clang)
+                results["units"][name][mode] = r
+                print("{:<15} {:<5} {:>9.2f}s {:>9.2f}s {:>11}B {:>10}KB".format(
+                    name, mode, r["frontend_s"], r["compile_s"], r["object_bytes"], r["peak_rss_kb"]))
+
+    if args.out:
+        with open(args.out, "w") as f:
+            json.dump(results, f, indent=2)
+    if args.baseline and regressions(results, args.baseline, args.tolerance):
+        sys.exit(1)
+
+
+def regressions(results, baseline_path, tolerance):
+    with open(baseline_path) as f:
+        baseline = json.load(f)
+    found = False
+    for name, modes in results["units"].items():
+        old = baseline["units"].get(name, {}).get("fstl")
+        if old is None:
+            continue
+        for metric in ("frontend_s", "compile_s", "peak_rss_kb"):
+            before, after = old[metric], modes["fstl"][metric]
+            if before > 0 and after > before * (1 + tolerance):
+                print("regression: {} {} {} -> {} (+{:.0%})".format(name, metric, before, after, after / before - 1))
+                found = True
+    return found
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,81 @@
+#include <benchmark/benchmark.h>
+
+#include "fstl/concurrent_unordered_map.h"
+#include "fstl/unordered_map.h"
+
+#include <mutex>
+#include <stdint.h>
+#include <thread>
+
+// Mixed workload on one map shared by all benchmark threads: mostly reads of a preloaded
+// key set, with one write in `write_every` operations.
+static constexpr uint64_t preloaded = 1 << 16;
+static constexpr uint64_t write_every = 8;
+
+static uint64_t next_key(uint64_t &state)
+{
+  uint64_t z = (state += 0x9E3779B97F4A7C15ull);
+  z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+  z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+  return (z ^ (z >> 31)) % preloaded;
+}
+
+// Baseline: a single lock around the whole map.
+struct locked_map {
+  void insert_or_assign(uint64_t key, uint64_t value)
+  {
+    std::lock_guard<std::mutex> guard(lock);
+    map[key] = value;
+  }
+
+  bool contains(uint64_t key)
+  {
+    std::lock_guard<std::mutex> guard(lock);
+    return map.count(key) != 0;
+  }
+
+  std::mutex lock;
+  fstl::unordered_map<uint64_t, uint64_t> map;
+};
+
+using sharded_map = fstl::concurrent_unordered_map<uint64_t, uint64_t>;
+
+template <class Map>
+static Map &shared_map()
+{
+  static Map map;
+  static const bool loaded = [] {
+    for (uint64_t key = 0; key < preloaded; ++key) map.insert_or_assign(key, key);
+    return true;
+  }();
+  (void)loaded;
+  return map;
+}
+
+template <class Map>
+static void mixed(benchmark::State &state)
+{
+  auto &map = shared_map<Map>();
+  uint64_t seed = state.thread_index() + 1;
+  uint64_t hits = 0;
+  for (auto _ : state) {
+    for (uint64_t op = 0; op < write_every; ++op) {
+      auto key = next_key(seed);
+      if (op == 0) map.insert_or_assign(key, op);
+      else hits += map.contains(key);
+    }
+  }
+  benchmark::DoNotOptimize(hits);
+  state.SetItemsProcessed(state.iterations() * write_every);
+}
+
+static int max_threads()
+{
+  auto threads = static_cast<int>(std::thread::hardware_concurrency());
+  return threads > 1 ? threads : 2;
+}
+
+BENCHMARK_TEMPLATE(mixed, locked_map)->ThreadRange(1, max_threads())->UseRealTime();
+BENCHMARK_TEMPLATE(mixed, sharded_map)->ThreadRange(1, max_threads())->UseRealTime();
+
+BENCHMARK_MAIN();
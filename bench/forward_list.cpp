@@ -0,0 +1,93 @@
+#include "common.h"
+
+#include "fstl/forward_list.h"
+
+template <class T>
+static fstl::forward_list<T> make_list(size_t count)
+{
+  fstl::forward_list<T> list;
+  for (size_t j = 0; j < count; ++j) list.push_front(make_value<T>(j));
+  return list;
+}
+
+template <class T>
+static void push_front(benchmark::State &state)
+{
+  auto value = make_value<T>(1);
+  for (auto _ : state) {
+    fstl::forward_list<T> list;
+    for (long j = 0; j < state.range(0); ++j) list.push_front(value);
+    benchmark::DoNotOptimize(&list.front());
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+// Unlinks every other node.
+template <class T>
+static void erase(benchmark::State &state)
+{
+  auto source = make_list<T>(state.range(0));
+  for (auto _ : state) {
+    state.PauseTiming();
+    auto list = source;
+    state.ResumeTiming();
+    for (auto it = list.begin(); it != list.end(); ++it) {
+      auto next = it;
+      if (++next == list.end()) break;
+      list.erase_after(it);
+    }
+    benchmark::DoNotOptimize(&list.front());
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+template <class T>
+static void build(benchmark::State &state)
+{
+  auto source = make_list<T>(state.range(0));
+  for (auto _ : state) {
+    auto list = source;
+    benchmark::DoNotOptimize(&list.front());
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+template <class T>
+static void iterate(benchmark::State &state)
+{
+  auto list = make_list<T>(state.range(0));
+  for (auto _ : state) {
+    size_t sum = 0;
+    for (auto &elem : list) sum += touch(elem);
+    benchmark::DoNotOptimize(sum);
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+template <class T>
+static void clear(benchmark::State &state)
+{
+  auto source = make_list<T>(state.range(0));
+  for (auto _ : state) {
+    state.PauseTiming();
+    auto list = source;
+    state.ResumeTiming();
+    list.clear();
+    benchmark::DoNotOptimize(list.empty());
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+#define LIST_BENCHMARK(fn, T) BENCHMARK_TEMPLATE(fn, T)->Apply(footprints<T>)
+#define LIST_BENCHMARKS(T) \
+  LIST_BENCHMARK(push_front, T); \
+  LIST_BENCHMARK(erase, T); \
+  LIST_BENCHMARK(build, T); \
+  LIST_BENCHMARK(iterate, T); \
+  LIST_BENCHMARK(clear, T)
+
+LIST_BENCHMARKS(uint64_t);
+LIST_BENCHMARKS(std::string);
+LIST_BENCHMARKS(payload);
+
+BENCHMARK_MAIN();
@@ -0,0 +1,123 @@
+#include <benchmark/benchmark.h>
+
+#include "fstl/functional/hash.h"
+#include "fstl/vector.h"
+
+#include <stdint.h>
+
+// Baseline: the byte hash fstl::hash used before hash_bytes (Paul Hsieh's SuperFastHash).
+#undef get16bits
+#if (defined(__GNUC__) && defined(__i386__)) || defined(__WATCOMC__) \
+ || defined(_MSC_VER) || defined (__BORLANDC__) || defined (__TURBOC__)
+#define get16bits(d) (*((const uint16_t *) (d)))
+#endif
+
+#if !defined (get16bits)
+#define get16bits(d) ((((uint32_t)(((const uint8_t *)(d))[1])) << 8)\
+                       +(uint32_t)(((const uint8_t *)(d))[0]) )
+#endif
+
+static uint32_t SuperFastHash(const char *data, int len) {
+  uint32_t hash = len, tmp;
+  int rem;
+
+  if (len <= 0 || data == nullptr) return 0;
+
+  rem = len & 3;
+  len >>= 2;
+
+  /* Main loop */
+  for (; len > 0; len--) {
+    hash += get16bits (data);
+    tmp = (get16bits (data + 2) << 11) ^ hash;
+    hash = (hash << 16) ^ tmp;
+    data += 2 * sizeof(uint16_t);
+    hash += hash >> 11;
+  }
+
+  /* Handle end cases */
+  switch (rem) {
+    case 3:
+      hash += get16bits (data);
+      hash ^= hash << 16;
+      hash ^= ((signed char) data[sizeof(uint16_t)]) << 18;
+      hash += hash >> 11;
+      break;
+    case 2:
+      hash += get16bits (data);
+      hash ^= hash << 11;
+      hash += hash >> 17;
+      break;
+    case 1:
+      hash += (signed char) *data;
+      hash ^= hash << 10;
+      hash += hash >> 1;
+  }
+
+  /* Force "avalanching" of final 127 bits */
+  hash ^= hash << 3;
+  hash += hash >> 5;
+  hash ^= hash << 4;
+  hash += hash >> 17;
+  hash ^= hash << 25;
+  hash += hash >> 6;
+
+  return hash;
+}
+
+static fstl::vector<char> make_bytes(size_t count)
+{
+  fstl::vector<char> bytes;
+  bytes.reserve(count);
+  uint64_t state = 1;
+  for (size_t j = 0; j < count; ++j) {
+    state = state * 6364136223846793005ull + 1442695040888963407ull;
+    bytes.push_back(static_cast<char>(state >> 56));
+  }
+  return bytes;
+}
+
+static void bytes_super_fast_hash(benchmark::State &state)
+{
+  auto bytes = make_bytes(state.range(0));
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(SuperFastHash(bytes.data(), static_cast<int>(bytes.size())));
+  }
+  state.SetBytesProcessed(state.iterations() * bytes.size());
+}
+
+static void bytes_hash_bytes(benchmark::State &state)
+{
+  auto bytes = make_bytes(state.range(0));
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(fstl::detail::hash_bytes(bytes.data(), bytes.size()));
+  }
+  state.SetBytesProcessed(state.iterations() * bytes.size());
+}
+
+// Word-sized keys, hashed back to back as a table insert loop would.
+static void int_super_fast_hash(benchmark::State &state)
+{
+  uint64_t key = 0;
+  for (auto _ : state) {
+    ++key;
+    benchmark::DoNotOptimize(SuperFastHash(reinterpret_cast<const char *>(&key), sizeof(key)));
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+
+static void int_hash(benchmark::State &state)
+{
+  uint64_t key = 0;
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(fstl::hash<uint64_t>{}(++key));
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+
+BENCHMARK(bytes_super_fast_hash)->RangeMultiplier(4)->Range(4, 1 << 14);
+BENCHMARK(bytes_hash_bytes)->RangeMultiplier(4)->Range(4, 1 << 14);
+BENCHMARK(int_super_fast_hash);
+BENCHMARK(int_hash);
+
+BENCHMARK_MAIN();
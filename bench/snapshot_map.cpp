@@ -0,0 +1,74 @@
+#include <benchmark/benchmark.h>
+
+#include "fstl/snapshot_map.h"
+
+#include <shared_mutex>
+#include <stdint.h>
+#include <thread>
+
+// Lookups in one snapshot shared by all benchmark threads, each under its own read lock: the
+// cost measured is mostly that of entering and leaving the read side.
+static constexpr uint64_t preloaded = 1 << 16;
+
+using table = fstl::snapshot_map<uint64_t, uint64_t>;
+
+static uint64_t next_key(uint64_t &state)
+{
+  uint64_t z = (state += 0x9E3779B97F4A7C15ull);
+  z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+  z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+  return (z ^ (z >> 31)) % preloaded;
+}
+
+static table *make_table()
+{
+  fstl::vector<fstl::pair<uint64_t, uint64_t>> pairs;
+  pairs.reserve(preloaded);
+  for (uint64_t key = 0; key < preloaded; ++key) pairs.push_back({key, key});
+  return new table(pairs);
+}
+
+// Baseline: readers share a reader-writer lock.
+struct locked_cell {
+  locked_cell() : current(make_table()) {}
+  ~locked_cell() { delete current; }
+
+  template <class Fn>
+  decltype(auto) read(Fn &&fn) const
+  {
+    std::shared_lock<std::shared_mutex> guard(lock);
+    return fn(static_cast<const table *>(current));
+  }
+
+  mutable std::shared_mutex lock;
+  table *current;
+};
+
+struct rcu_cell : fstl::rcu_cell<table> {
+  rcu_cell() : fstl::rcu_cell<table>(make_table()) {}
+};
+
+template <class Cell>
+static void reads(benchmark::State &state)
+{
+  static Cell cell;
+  uint64_t seed = state.thread_index() + 1;
+  uint64_t hits = 0;
+  for (auto _ : state) {
+    auto key = next_key(seed);
+    hits += cell.read([&](const table *snapshot) { return snapshot->contains(key); });
+  }
+  benchmark::DoNotOptimize(hits);
+  state.SetItemsProcessed(state.iterations());
+}
+
+static int max_threads()
+{
+  auto threads = static_cast<int>(std::thread::hardware_concurrency());
+  return threads > 1 ? threads : 2;
+}
+
+BENCHMARK_TEMPLATE(reads, locked_cell)->ThreadRange(1, max_threads())->UseRealTime();
+BENCHMARK_TEMPLATE(reads, rcu_cell)->ThreadRange(1, max_threads())->UseRealTime();
+
+BENCHMARK_MAIN();
@@ -0,0 +1,301 @@
+#include "common.h"
+
+#include "fstl/unordered_map.h"
+#include "fstl/vector.h"
+#ifndef FSTL_USE_STD_LIB
+#include "fstl/frozen_map.h"
+#include "fstl/snapshot_map.h"
+#endif
+
+#include <stdint.h>
+#include <string>
+
+// The chained map in the fstl build and std::unordered_map in the std one, under the same
+// names so that compare.py pairs their results.
+using map_u64 = fstl::unordered_map<uint64_t, uint64_t>;
+using string_map = fstl::unordered_map<std::string, uint64_t>;
+#ifndef FSTL_USE_STD_LIB
+using flat_map = fstl::unordered_map<uint64_t, uint64_t, fstl::hash<uint64_t>,
+                                     fstl::detail::equal_to<uint64_t>,
+                                     fstl::detail::default_allocator<fstl::pair<const uint64_t, uint64_t>>,
+                                     fstl::open_addressing>;
+using flat_string_map = fstl::unordered_map<std::string, uint64_t, fstl::hash<std::string>,
+                                            fstl::detail::equal_to<std::string>,
+                                            fstl::detail::default_allocator<fstl::pair<const std::string, uint64_t>>,
+                                            fstl::open_addressing>;
+using robin_hood_map = fstl::unordered_map<uint64_t, uint64_t, fstl::hash<uint64_t>,
+                                           fstl::detail::equal_to<uint64_t>,
+                                           fstl::detail::default_allocator<fstl::pair<const uint64_t, uint64_t>>,
+                                           fstl::robin_hood>;
+using frozen_map = fstl::frozen_map<uint64_t, uint64_t>;
+using snapshot_map = fstl::snapshot_map<uint64_t, uint64_t>;
+#endif
+
+// Deterministic, well spread keys (splitmix64).
+static fstl::vector<uint64_t> make_keys(size_t count, uint64_t seed)
+{
+  fstl::vector<uint64_t> keys;
+  keys.reserve(count);
+  for (size_t j = 0; j < count; ++j) {
+    uint64_t z = (seed += 0x9E3779B97F4A7C15ull);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+    keys.push_back(z ^ (z >> 31));
+  }
+  return keys;
+}
+
+template <class Map>
+static void insert(benchmark::State &state)
+{
+  auto keys = make_keys(state.range(0), 1);
+  for (auto _ : state) {
+    Map map;
+    for (auto key : keys) map.insert({key, key});
+    benchmark::DoNotOptimize(map);
+  }
+  state.SetItemsProcessed(state.iterations() * keys.size());
+}
+
+template <class Map>
+static void lookup_hit(benchmark::State &state)
+{
+  auto keys = make_keys(state.range(0), 1);
+  Map map;
+  for (auto key : keys) map.insert({key, key});
+  for (auto _ : state) {
+    uint64_t sum = 0;
+    for (auto key : keys) sum += map.find(key)->second;
+    benchmark::DoNotOptimize(sum);
+  }
+  state.SetItemsProcessed(state.iterations() * keys.size());
+}
+
+template <class Map>
+static void lookup_miss(benchmark::State &state)
+{
+  auto keys = make_keys(state.range(0), 1);
+  auto misses = make_keys(state.range(0), 2);
+  Map map;
+  for (auto key : keys) map.insert({key, key});
+  for (auto _ : state) {
+    size_t found = 0;
+    for (auto key : misses) found += map.count(key);
+    benchmark::DoNotOptimize(found);
+  }
+  state.SetItemsProcessed(state.iterations() * misses.size());
+}
+
+// A full scan of a map that was sized for 16 times its elements, as after erasing most of them.
+template <class Map>
+static void iterate_sparse(benchmark::State &state)
+{
+  auto keys = make_keys(state.range(0), 1);
+  Map map;
+  map.reserve(keys.size() * 16);
+  for (auto key : keys) map.insert({key, key});
+  for (auto _ : state) {
+    uint64_t sum = 0;
+    for (auto &pair : map) sum += pair.second;
+    benchmark::DoNotOptimize(sum);
+  }
+  state.SetItemsProcessed(state.iterations() * keys.size());
+}
+
+template <class Map>
+static Map make_map(size_t count)
+{
+  Map map;
+  for (auto key : make_keys(count, 1)) map.insert({key, key});
+  return map;
+}
+
+template <class Map>
+static void build(benchmark::State &state)
+{
+  auto source = make_map<Map>(state.range(0));
+  for (auto _ : state) {
+    auto map = source;
+    benchmark::DoNotOptimize(map);
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+template <class Map>
+static void iterate(benchmark::State &state)
+{
+  auto map = make_map<Map>(state.range(0));
+  for (auto _ : state) {
+    uint64_t sum = 0;
+    for (auto &pair : map) sum += pair.second;
+    benchmark::DoNotOptimize(sum);
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+template <class Map>
+static void erase(benchmark::State &state)
+{
+  auto keys = make_keys(state.range(0), 1);
+  auto source = make_map<Map>(keys.size());
+  for (auto _ : state) {
+    state.PauseTiming();
+    auto map = source;
+    state.ResumeTiming();
+    for (auto key : keys) map.erase(key);
+    benchmark::DoNotOptimize(map);
+  }
+  state.SetItemsProcessed(state.iterations() * keys.size());
+}
+
+template <class Map>
+static void clear(benchmark::State &state)
+{
+  auto source = make_map<Map>(state.range(0));
+  for (auto _ : state) {
+    state.PauseTiming();
+    auto map = source;
+    state.ResumeTiming();
+    map.clear();
+    benchmark::DoNotOptimize(map);
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+// String keys: hashing and comparing them costs more than the probe itself at small sizes.
+template <class Map>
+static void lookup_string(benchmark::State &state)
+{
+  fstl::vector<std::string> keys;
+  Map map;
+  for (long j = 0; j < state.range(0); ++j) {
+    keys.push_back(make_value<std::string>(j));
+    map.insert({keys.back(), uint64_t(j)});
+  }
+  for (auto _ : state) {
+    uint64_t sum = 0;
+    for (auto &key : keys) sum += map.find(key)->second;
+    benchmark::DoNotOptimize(sum);
+  }
+  state.SetItemsProcessed(state.iterations() * keys.size());
+}
+
+// Keys are looked up in a different order than they were inserted, so that node maps do not
+// get sequential memory accesses for free.
+static fstl::vector<uint64_t> shuffled(fstl::vector<uint64_t> keys)
+{
+  uint64_t state = 3;
+  for (size_t j = keys.size(); j > 1; --j) {
+    state = state * 6364136223846793005ull + 1442695040888963407ull;
+    auto other = (state >> 33) % j;
+    auto tmp = keys[j - 1];
+    keys[j - 1] = keys[other];
+    keys[other] = tmp;
+  }
+  return keys;
+}
+
+template <class Map>
+static void lookup_shuffled(benchmark::State &state)
+{
+  auto keys = make_keys(state.range(0), 1);
+  Map map;
+  for (auto key : keys) map.insert({key, key});
+  auto lookups = shuffled(keys);
+  for (auto _ : state) {
+    uint64_t sum = 0;
+    for (auto key : lookups) sum += map.find(key)->second;
+    benchmark::DoNotOptimize(sum);
+  }
+  state.SetItemsProcessed(state.iterations() * keys.size());
+}
+
+#ifndef FSTL_USE_STD_LIB
+template <class Map>
+static void lookup_batch(benchmark::State &state)
+{
+  constexpr size_t batch = 1024;
+  auto keys = make_keys(state.range(0), 1);
+  Map map;
+  for (auto key : keys) map.insert({key, key});
+  auto lookups = shuffled(keys);
+  typename Map::value_type *found[batch];
+  for (auto _ : state) {
+    uint64_t sum = 0;
+    for (size_t first = 0; first < lookups.size(); first += batch) {
+      auto n = lookups.size() - first < batch ? lookups.size() - first : batch;
+      map.find_batch(lookups.data() + first, n, found);
+      for (size_t j = 0; j < n; ++j) sum += found[j]->second;
+    }
+    benchmark::DoNotOptimize(sum);
+  }
+  state.SetItemsProcessed(state.iterations() * keys.size());
+}
+
+// Immutable maps, built from a chained map holding the same keys.
+template <class Map>
+static void lookup_immutable(benchmark::State &state)
+{
+  auto keys = make_keys(state.range(0), 1);
+  map_u64 source;
+  for (auto key : keys) source.insert({key, key});
+  Map map(source);
+  auto lookups = shuffled(keys);
+  for (auto _ : state) {
+    uint64_t sum = 0;
+    for (auto key : lookups) sum += map.find(key)->second;
+    benchmark::DoNotOptimize(sum);
+  }
+  state.SetItemsProcessed(state.iterations() * keys.size());
+}
+#endif
+
+#define MAP_BENCHMARK(fn, map) BENCHMARK_TEMPLATE(fn, map)->RangeMultiplier(4)->Range(1 << 8, 1 << 16)
+// From L1 to DRAM sized, counting 16 bytes per element.
+#define FOOTPRINT_MAP_BENCHMARK(fn, map) BENCHMARK_TEMPLATE(fn, map)->Apply(footprints<uint64_t[2]>)
+
+// Up to 4M entries: well past the last level cache, where batching pays off.
+#define LARGE_MAP_BENCHMARK(fn, map) BENCHMARK_TEMPLATE(fn, map)->RangeMultiplier(4)->Range(1 << 16, 1 << 22)
+
+FOOTPRINT_MAP_BENCHMARK(insert, map_u64);
+FOOTPRINT_MAP_BENCHMARK(lookup_hit, map_u64);
+FOOTPRINT_MAP_BENCHMARK(lookup_miss, map_u64);
+MAP_BENCHMARK(iterate_sparse, map_u64);
+FOOTPRINT_MAP_BENCHMARK(build, map_u64);
+FOOTPRINT_MAP_BENCHMARK(iterate, map_u64);
+FOOTPRINT_MAP_BENCHMARK(erase, map_u64);
+FOOTPRINT_MAP_BENCHMARK(clear, map_u64);
+MAP_BENCHMARK(lookup_string, string_map);
+LARGE_MAP_BENCHMARK(lookup_shuffled, map_u64);
+
+#ifndef FSTL_USE_STD_LIB
+FOOTPRINT_MAP_BENCHMARK(insert, flat_map);
+FOOTPRINT_MAP_BENCHMARK(insert, robin_hood_map);
+FOOTPRINT_MAP_BENCHMARK(lookup_hit, flat_map);
+FOOTPRINT_MAP_BENCHMARK(lookup_hit, robin_hood_map);
+FOOTPRINT_MAP_BENCHMARK(lookup_miss, flat_map);
+FOOTPRINT_MAP_BENCHMARK(lookup_miss, robin_hood_map);
+MAP_BENCHMARK(iterate_sparse, flat_map);
+MAP_BENCHMARK(iterate_sparse, robin_hood_map);
+FOOTPRINT_MAP_BENCHMARK(build, flat_map);
+FOOTPRINT_MAP_BENCHMARK(build, robin_hood_map);
+FOOTPRINT_MAP_BENCHMARK(iterate, flat_map);
+FOOTPRINT_MAP_BENCHMARK(iterate, robin_hood_map);
+FOOTPRINT_MAP_BENCHMARK(erase, flat_map);
+FOOTPRINT_MAP_BENCHMARK(erase, robin_hood_map);
+FOOTPRINT_MAP_BENCHMARK(clear, flat_map);
+FOOTPRINT_MAP_BENCHMARK(clear, robin_hood_map);
+MAP_BENCHMARK(lookup_string, flat_string_map);
+MAP_BENCHMARK(lookup_immutable, frozen_map);
+MAP_BENCHMARK(lookup_immutable, snapshot_map);
+
+LARGE_MAP_BENCHMARK(lookup_shuffled, flat_map);
+LARGE_MAP_BENCHMARK(lookup_shuffled, robin_hood_map);
+LARGE_MAP_BENCHMARK(lookup_batch, map_u64);
+LARGE_MAP_BENCHMARK(lookup_batch, flat_map);
+LARGE_MAP_BENCHMARK(lookup_batch, robin_hood_map);
+LARGE_MAP_BENCHMARK(lookup_immutable, frozen_map);
+LARGE_MAP_BENCHMARK(lookup_immutable, snapshot_map);
+#endif
+
+BENCHMARK_MAIN();
@@ -0,0 +1,106 @@
+#include "common.h"
+
+#include "fstl/vector.h"
+
+template <class T>
+static fstl::vector<T> make_vector(size_t count)
+{
+  fstl::vector<T> v;
+  v.reserve(count);
+  for (size_t j = 0; j < count; ++j) v.push_back(make_value<T>(j));
+  return v;
+}
+
+template <class T>
+static void push_back(benchmark::State &state)
+{
+  auto value = make_value<T>(1);
+  for (auto _ : state) {
+    fstl::vector<T> v;
+    for (long j = 0; j < state.range(0); ++j) v.push_back(value);
+    benchmark::DoNotOptimize(v.data());
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+// One range insert of half the elements into the middle of the other half.
+template <class T>
+static void insert(benchmark::State &state)
+{
+  auto half = make_vector<T>(state.range(0) / 2);
+  for (auto _ : state) {
+    state.PauseTiming();
+    auto v = half;
+    state.ResumeTiming();
+    v.insert(v.begin() + v.size() / 2, half.begin(), half.end());
+    benchmark::DoNotOptimize(v.data());
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+// Erases the first half, shifting the second half down.
+template <class T>
+static void erase(benchmark::State &state)
+{
+  auto source = make_vector<T>(state.range(0));
+  for (auto _ : state) {
+    state.PauseTiming();
+    auto v = source;
+    state.ResumeTiming();
+    v.erase(v.begin(), v.begin() + v.size() / 2);
+    benchmark::DoNotOptimize(v.data());
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+template <class T>
+static void build(benchmark::State &state)
+{
+  auto source = make_vector<T>(state.range(0));
+  for (auto _ : state) {
+    auto v = source;
+    benchmark::DoNotOptimize(v.data());
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+template <class T>
+static void iterate(benchmark::State &state)
+{
+  auto v = make_vector<T>(state.range(0));
+  for (auto _ : state) {
+    size_t sum = 0;
+    for (auto &elem : v) sum += touch(elem);
+    benchmark::DoNotOptimize(sum);
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+template <class T>
+static void clear(benchmark::State &state)
+{
+  auto source = make_vector<T>(state.range(0));
+  for (auto _ : state) {
+    state.PauseTiming();
+    auto v = source;
+    state.ResumeTiming();
+    v.clear();
+    benchmark::DoNotOptimize(v.data());
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+#define VECTOR_BENCHMARK(fn, T) BENCHMARK_TEMPLATE(fn, T)->Apply(footprints<T>)
+#define VECTOR_BENCHMARKS(T) \
+  VECTOR_BENCHMARK(push_back, T); \
+  VECTOR_BENCHMARK(insert, T); \
+  VECTOR_BENCHMARK(erase, T); \
+  VECTOR_BENCHMARK(build, T); \
+  VECTOR_BENCHMARK(iterate, T); \
+  VECTOR_BENCHMARK(clear, T)
+
+VECTOR_BENCHMARKS(uint64_t);
+VECTOR_BENCHMARKS(std::string);
+VECTOR_BENCHMARKS(payload);
+
+BENCHMARK_MAIN();
@@ -0,0 +1,115 @@
+#pragma once
+
+#ifndef FSTL_CONCURRENT_UNORDERED_MAP_H
+#define FSTL_CONCURRENT_UNORDERED_MAP_H
+
+#ifdef FSTL_USE_STD_LIB
+#error "fstl::concurrent_unordered_map has no standard library counterpart"
+#endif
+
+#include "fstl/unordered_map.h"
+
+namespace fstl {
+namespace detail {
+// Chained maps split into shards, each guarded by its own reader-writer lock. The high bits
+// of the mixed hash pick the shard and the shard's buckets use the low bits of the hash, so
+// the two stay independent. Each key is hashed once, outside any lock.
+class concurrent_map_base {
+public:
+  using size_type = unsigned long;
+
+  concurrent_map_base(size_type shard_count,
+    detail::erased_hash_base *hash,
+    detail::erased_compare_base *key_eq,
+    detail::erased_allocator_base *alloc);
+  concurrent_map_base(const concurrent_map_base &) = delete;
+  concurrent_map_base &operator=(const concurrent_map_base &) = delete;
+  ~concurrent_map_base();
+
+  size_type shard_count() const { return size_type(1) << m_shard_bits; }
+  // Sums the shards one at a time: exact only while no other thread modifies the map.
+  size_type size() const;
+  void clear();
+
+protected:
+  // Under the shard's write lock: constructs the pair with construct(slot, construct_state)
+  // if the key is new, otherwise calls assign(pair, assign_state). True if inserted.
+  bool insert_or_assign(const void *key, void *construct_state, void (construct)(void *, void *),
+                        void *assign_state, void (assign)(void *, void *));
+  // Under the shard's read lock: calls visit(pair, state) on the element if present.
+  bool find_and_visit(const void *key, void *state, void (visit)(void *, void *)) const;
+  size_type erase(const void *key);
+
+private:
+  struct shard;
+  shard &shard_for(size_type hash) const;
+
+  shard *m_shards;
+  detail::erased_hash_base *m_hash;
+  unsigned m_shard_bits;
+};
+}
+
+// Hash map for concurrent use from many threads. Elements are only reachable through
+// callbacks run under the lock of their shard, as a reference could not outlive it safely.
+template <typename Key,
+  typename Value,
+  typename Hash = fstl::hash<Key>,
+  typename KeyEqual = fstl::detail::equal_to<Key>,
+  typename Allocator = fstl::detail::default_allocator<fstl::pair<const Key, Value>>
+  >
+class concurrent_unordered_map : public detail::concurrent_map_base
+{
+  static_assert(alignof(fstl::pair<const Key, Value>) <= detail::ll_node_header_size,
+                "concurrent_unordered_map does not support over-aligned types");
+  using base = detail::concurrent_map_base;
+public:
+  using size_type = base::size_type;
+  using value_type = fstl::pair<const Key, Value>;
+
+  // The shard count is rounded up to a power of two; a few times the number of threads
+  // expected to write at once keeps lock contention low.
+  explicit concurrent_unordered_map(size_type shard_count = 64,
+                                    const Hash &hash = Hash(),
+                                    const KeyEqual &equal = KeyEqual(),
+                                    const Allocator &alloc = Allocator())
+  : base(
+      shard_count,
+      detail::make_adapter<detail::erased_hash<Hash>>(hash),
+      detail::make_adapter<detail::erased_key_equal<KeyEqual, Value>>(equal),
+      detail::make_adapter<detail::erased_pair_allocator<Allocator, const Key, Value>>(alloc))
+  {
+  }
+
+  template <class V>
+  bool insert_or_assign(const Key &key, V &&value)
+  {
+    auto construct = [&](void *slot) { ::new(slot) value_type(key, static_cast<V &&>(value)); };
+    auto assign = [&](void *pair) { static_cast<value_type *>(pair)->second = static_cast<V &&>(value); };
+    return base::insert_or_assign(&key, &construct, &invoke<decltype(construct)>,
+                                  &assign, &invoke<decltype(assign)>);
+  }
+
+  // Calls fn(const value_type &) on the element with `key`, if any, under a shared lock;
+  // fn must not call back into the map.
+  template <class Fn>
+  bool find_and_visit(const Key &key, Fn &&fn) const
+  {
+    auto visit = [&](void *pair) { fn(*static_cast<const value_type *>(pair)); };
+    return base::find_and_visit(&key, &visit, &invoke<decltype(visit)>);
+  }
+
+  bool contains(const Key &key) const
+  {
+    return find_and_visit(key, [](const value_type &) {});
+  }
+
+  size_type erase(const Key &key) { return base::erase(&key); }
+
+private:
+  template<class Fn>
+  static void invoke(void *slot, void *fn) { (*static_cast<Fn *>(fn))(slot); }
+};
+}
+
+#endif //FSTL_CONCURRENT_UNORDERED_MAP_H
@@ -0,0 +1,52 @@
+#pragma once
+
+#ifndef FSTL_ERASED_ADAPTER_H
+#define FSTL_ERASED_ADAPTER_H
+
+namespace fstl::detail {
+// Common base of the type-erased allocator, hash and compare adapters held by containers.
+struct erased_adapter {
+  erased_adapter() = default;
+  // A copy is a new, unshared adapter with a single owner.
+  erased_adapter(const erased_adapter &) {}
+  erased_adapter &operator=(const erased_adapter &) = delete;
+
+  bool is_shared() const { return m_shared; }
+
+  bool m_shared = false;
+  // Owners of an unshared adapter: its container, plus node handles holding its nodes.
+  // Updated atomically as handles may be released on another thread.
+  unsigned m_refs = 1;
+};
+
+// Adapters around stateless (empty) objects are immutable, so a single instance per type is
+// shared by every container instead of heap allocating one per container.
+template <class Adapter, class Object>
+Adapter *make_adapter(const Object &obj)
+{
+  if constexpr (__is_empty(Object)) {
+    static Adapter shared{obj};
+    static const bool marked = (shared.m_shared = true);
+    (void)marked;
+    return &shared;
+  } else {
+    return new Adapter{obj};
+  }
+}
+
+template <class Adapter>
+Adapter *retain_adapter(Adapter *adapter)
+{
+  if (adapter && !adapter->is_shared()) __atomic_fetch_add(&adapter->m_refs, 1, __ATOMIC_RELAXED);
+  return adapter;
+}
+
+template <class Adapter>
+void release_adapter(Adapter *adapter)
+{
+  if (adapter && !adapter->is_shared() && __atomic_sub_fetch(&adapter->m_refs, 1, __ATOMIC_ACQ_REL) == 0)
+    delete adapter;
+}
+}
+
+#endif //FSTL_ERASED_ADAPTER_H
@@ -3,11 +3,12 @@
 #ifndef FSTL_ERASED_ALLOCATOR_H
 #define FSTL_ERASED_ALLOCATOR_H
 
+#include "fstl/detail/erased_adapter.h"
+#include "fstl/detail/precompiled.h"
 #include "fstl/type_traits.h"
+#include <cstddef>
 #include <new>
 
-extern "C" void* calloc( size_t num, size_t size ) noexcept;
-
 namespace fstl {
 using size_t = unsigned long;
 namespace detail {
@@ -17,18 +18,33 @@ struct default_allocator {
 
   template< class U > struct rebind { using other = default_allocator<U>; };
 
+  default_allocator() = default;
+  template <class U>
+  default_allocator(const default_allocator<U> &) {}
+
   T *allocate(size_t n) { return (T*) ::operator new( n * sizeof (T)); }
 
-  void deallocate(T *p, size_t n) { ::operator delete(p, n); }
+  void deallocate(T *p, size_t n) { ::operator delete(p, n * sizeof(T)); }
 };
 
-struct erased_allocator_base {
+struct erased_allocator_base : erased_adapter {
+  erased_allocator_base(bool trivially_copyable, bool trivially_relocatable)
+    : m_trivially_copyable(trivially_copyable)
+    , m_trivially_relocatable(trivially_relocatable) {}
+
   virtual erased_allocator_base *clone() = 0;
 
   virtual void *allocate(size_t n) = 0;
 
   virtual void deallocate(void *p, size_t n) = 0;
 
+  // Storage for one node of a node based container, aligned to ll_node_header_size: `bytes`
+  // covers the node header and one element. Allocators with allocate_node/deallocate_node
+  // members (such as pool_allocator) serve these themselves; others are rebound to node_unit.
+  virtual void *allocate_node(size_t bytes) = 0;
+
+  virtual void deallocate_node(void *p, size_t bytes) = 0;
+
   virtual void construct(void *p) = 0;
 
   virtual void construct_copy(void *p, const void *val) = 0;
@@ -42,23 +58,81 @@ struct erased_allocator_base {
 
   virtual size_t element_size() const = 0;
 
+  // Copies may be done with memcpy instead of construct_copy.
+  bool trivially_copyable() const { return m_trivially_copyable; }
+  // Moving an element may be done with memmove instead of construct_move + destruct.
+  bool trivially_relocatable() const { return m_trivially_relocatable; }
+
   virtual ~erased_allocator_base() {};
+
+private:
+  const bool m_trivially_copyable;
+  const bool m_trivially_relocatable;
 };
 
+// Nodes are a single allocation: the link, padded to this size, then the element.
+constexpr size_t ll_node_header_size = alignof(std::max_align_t);
+
+// Allocators only align storage for their own value_type, so nodes are allocated as arrays of
+// these through the allocator rebound to it.
+struct alignas(ll_node_header_size) node_unit { char bytes[ll_node_header_size]; };
+
+template <class Alloc, class = void>
+struct node_unit_allocator { using type = void; };
+
+template <class Alloc>
+struct node_unit_allocator<Alloc, void_t<decltype(typename Alloc::template rebind<node_unit>::other(
+                                           type_traits_detail::declval<const Alloc &>()))>> {
+  using type = typename Alloc::template rebind<node_unit>::other;
+};
+
+template <class Alloc, class = void>
+struct has_node_allocation : false_type {};
+
+template <class Alloc>
+struct has_node_allocation<Alloc, void_t<decltype(type_traits_detail::declval<Alloc &>().allocate_node(size_t{}))>>
+  : true_type {};
+
 template<typename Alloc>
 struct erased_allocator : public erased_allocator_base {
   using value_type = typename Alloc::value_type;
 
-  virtual erased_allocator_base *clone() {
+  virtual erased_allocator_base *clone() override {
+    if (is_shared()) return this;
     return new erased_allocator{allocator};
   }
 
-  erased_allocator(const Alloc &alloc) : allocator(alloc) {}
+  erased_allocator(const Alloc &alloc)
+    : erased_allocator_base(fstl::is_trivially_copyable<value_type>::value,
+                            fstl::is_trivially_relocatable<value_type>::value)
+    , allocator(alloc) {}
 
   virtual void *allocate(size_t n) override { return allocator.allocate(n); }
 
   virtual void deallocate(void *p, size_t n) override { allocator.deallocate(static_cast<value_type *>(p), n); }
 
+  virtual void *allocate_node(size_t bytes) override {
+    if constexpr (has_node_allocation<Alloc>::value) {
+      return allocator.allocate_node(bytes);
+    } else if constexpr (aligned_for_nodes) {
+      return allocator.allocate(node_units(bytes));
+    } else {
+      node_allocator nodes(allocator);
+      return nodes.allocate(node_unit_count(bytes));
+    }
+  }
+
+  virtual void deallocate_node(void *p, size_t bytes) override {
+    if constexpr (has_node_allocation<Alloc>::value) {
+      allocator.deallocate_node(p, bytes);
+    } else if constexpr (aligned_for_nodes) {
+      allocator.deallocate(static_cast<value_type *>(p), node_units(bytes));
+    } else {
+      node_allocator nodes(allocator);
+      nodes.deallocate(static_cast<node_unit *>(p), node_unit_count(bytes));
+    }
+  }
+
   virtual void construct(void *p) override {
     if constexpr(fstl::is_default_constructible<value_type>::value)
       ::new(p) value_type{};
@@ -77,8 +151,22 @@ struct erased_allocator : public erased_allocator_base {
 
   virtual size_t element_size() const override { return sizeof(value_type); }
 
+  static size_t node_units(size_t bytes) { return (bytes + sizeof(value_type) - 1) / sizeof(value_type); }
+  static size_t node_unit_count(size_t bytes) { return (bytes + sizeof(node_unit) - 1) / sizeof(node_unit); }
+
+  using node_allocator = typename node_unit_allocator<Alloc>::type;
+  // Elements aligned like nodes need no rebinding. Neither can allocators without a rebind
+  // to construct from this one, which then must align their storage for nodes themselves.
+  static constexpr bool aligned_for_nodes =
+    alignof(value_type) >= alignof(node_unit) || is_same<node_allocator, void>::value;
+
   Alloc allocator;
 };
+
+// The allocators of vector and forward_list of fundamental types, built in the library.
+#define FSTL_EXTERN_ALLOCATOR(T) FSTL_EXTERN template struct erased_allocator<default_allocator<T>>;
+FSTL_PRECOMPILED_TYPES(FSTL_EXTERN_ALLOCATOR)
+#undef FSTL_EXTERN_ALLOCATOR
 }
 }
 
@@ -3,10 +3,18 @@
 #ifndef FSTL_ERASED_COMPARE_H
 #define FSTL_ERASED_COMPARE_H
 
+#include "fstl/detail/erased_adapter.h"
+
 namespace fstl::detail {
-struct erased_compare_base {
+struct erased_compare_base : erased_adapter {
+  virtual erased_compare_base *clone() = 0;
   virtual bool compare_eq(const void *, const void *) = 0;
+  virtual ~erased_compare_base() {}
 };
+
+// Compares a lookup key of some other type than the container's key with a stored element.
+// Containers instantiate one per transparent lookup type, as the adapter only knows the key.
+using erased_key_eq_fn = bool (*)(erased_compare_base *equal, const void *key, const void *stored);
 }
 
 #endif //FSTL_ERASED_COMPARE_H
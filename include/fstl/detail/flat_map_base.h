@@ -0,0 +1,127 @@
+#pragma once
+
+#ifndef FSTL_FLAT_MAP_BASE_H
+#define FSTL_FLAT_MAP_BASE_H
+
+#include "fstl/detail/erased_allocator.h"
+#include "fstl/detail/erased_compare.h"
+#include "fstl/functional/hash.h"
+#include "fstl/hash_table_stats.h"
+#include "fstl/utility.h"
+
+namespace fstl::detail {
+
+struct flat_map_iterator_base {
+  struct flat_map_base const *m_map = nullptr;
+  size_t m_index = 0;
+
+  void *data() const;
+  flat_map_iterator_base &next();
+
+  bool operator ==(const flat_map_iterator_base &other) const { return m_index == other.m_index; }
+  bool operator !=(const flat_map_iterator_base &other) const { return m_index != other.m_index; }
+};
+
+// Open addressing table: elements live directly in one flat array of slots, next to an array
+// of control bytes holding either "empty", "deleted" or 7 bits of the hash of the slot's key.
+// Lookups scan the control bytes a group of 16 at a time and only touch the slots whose
+// control byte matches, so there is no per-element allocation and no pointer chasing.
+struct flat_map_base {
+  friend struct flat_map_iterator_base;
+public:
+  using size_type = unsigned long;
+  using iterator = flat_map_iterator_base;
+  using emplace_handle = void *;
+
+  flat_map_base(size_type capacity,
+    detail::erased_hash_base *hash,
+    detail::erased_compare_base *key_eq,
+    detail::erased_allocator_base *alloc);
+  flat_map_base(const flat_map_base &other);
+  flat_map_base(flat_map_base &&other) noexcept;
+  flat_map_base &operator=(const flat_map_base &other);
+  flat_map_base &operator=(flat_map_base &&other) noexcept;
+  ~flat_map_base();
+
+  size_type bucket_count() const { return m_capacity; }
+  size_type bucket_size(size_type slot) const;
+
+  float load_factor() const { return m_capacity ? float(m_size) / m_capacity : 0.f; }
+  // The maximum load factor is fixed at 7/8 by the group probing; the setter is accepted for
+  // interface compatibility with the chained engine and ignored.
+  float max_load_factor() const { return 0.875f; }
+  void max_load_factor(float) {}
+  void rehash(size_type count);
+  void reserve(size_type count);
+
+  size_type size() const { return m_size; }
+  // Probe length histogram and hash quality. Hashes every key again, since the table only
+  // keeps 7 bits of each hash, and counts them per group in a temporary array.
+  hash_table_stats stats() const;
+
+  void clear();
+
+protected:
+  fstl::pair<iterator, bool> insert_copy(const void *key, const void *pair);
+  // In-place construction: the caller constructs the pair in emplace_data(prepare_emplace())
+  // and commits it. If the key is already present the new pair is destroyed.
+  emplace_handle prepare_emplace();
+  static void *emplace_data(emplace_handle slot) { return slot; }
+  fstl::pair<iterator, bool> commit_emplace(emplace_handle slot);
+
+  void *at(const void *key);
+  void *operator[](const void *key);
+  size_type count(const void *key) const;
+  iterator find(const void *key) const;
+  iterator begin() const;
+  iterator end() const { return {this, m_capacity}; }
+
+  // Batched lookup of `count` keys laid out `stride` bytes apart: out[j] is the element with
+  // the j-th key, or null. Hashes a group of keys and prefetches their memory before
+  // resolving any of them, so the cache misses overlap.
+  void find_batch(const void *keys, size_t stride, size_type count, void **out) const;
+  void contains_batch(const void *keys, size_t stride, size_type count, bool *out) const;
+
+  size_type erase(const void *key);
+  iterator erase(iterator pos);
+  // Moves every element of `other` whose key is not present here.
+  void merge(flat_map_base &other);
+  // Transparent lookup: `hash` is the user hash of `key` and `eq` compares it with a stored pair.
+  iterator find(const void *key, size_type hash, erased_key_eq_fn eq) const;
+  erased_hash_base *hasher() const { return m_hash; }
+  erased_compare_base *key_eq() const { return m_equal; }
+  [[noreturn]] static void throw_out_of_range();
+
+private:
+  void *slot(size_type idx) const { return m_slots + idx * m_elem_size; }
+  size_type hash_of(const void *key) const;
+  size_type find_index(const void *key, size_type hash) const;
+  template <class Eq>
+  size_type probe(size_type hash, Eq &&eq) const;
+  size_type find_free(size_type hash) const;
+  size_type claim(size_type hash);
+  void erase_slot(size_type idx);
+  size_type next_full(size_type idx) const;
+  void allocate_table(size_type capacity);
+  void deallocate_table();
+  void relocate(void *dst, void *src) const;
+  // keep_staged moves the pair in the staging slot to that of the new table.
+  void resize(size_type capacity, bool keep_staged = false);
+  void reserve_one(bool keep_staged = false);
+
+  signed char *m_ctrl = nullptr;
+  char *m_slots = nullptr;
+  detail::erased_allocator_base *m_alloc;
+  detail::erased_hash_base *m_hash;
+  detail::erased_compare_base *m_equal;
+  size_t m_elem_size;
+
+  size_type m_size = 0;
+  size_type m_capacity = 0;
+  // Inserts left before the table must grow; tombstones count as used.
+  size_type m_growth_left = 0;
+};
+
+} // end namespace fstl::detail
+
+#endif //FSTL_FLAT_MAP_BASE_H
@@ -0,0 +1,73 @@
+#pragma once
+
+#ifndef FSTL_DETAIL_INSTRUMENT_H
+#define FSTL_DETAIL_INSTRUMENT_H
+
+#include "fstl/detail/erased_allocator.h"
+#include "fstl/functional/hash.h"
+#include "fstl/instrument.h"
+
+namespace fstl::detail {
+// Counters are only ever added to, relaxed; each container type has its own cache lines.
+struct alignas(64) instrument_counters {
+  instrument::stats stats;
+};
+extern instrument_counters instrument_table[instrument::container_count];
+
+inline void instrument_add(instrument::container kind, unsigned long instrument::stats::*counter, unsigned long n)
+{
+  __atomic_fetch_add(&(instrument_table[unsigned(kind)].stats.*counter), n, __ATOMIC_RELAXED);
+}
+
+void instrument_probe(instrument::container kind, unsigned long length);
+
+#ifdef FSTL_INSTRUMENT
+erased_allocator_base *counting_allocator(erased_allocator_base *alloc, instrument::container kind);
+erased_hash_base *counting_hash(erased_hash_base *hash, instrument::container kind);
+erased_hash_base *uncounted_hash(erased_hash_base *hash);
+#endif
+
+// The base classes pass the adapters they are given through these. Instrumented, they wrap
+// them in adapters that count every call before forwarding it; otherwise they are no-ops.
+inline erased_allocator_base *instrumented(erased_allocator_base *alloc, instrument::container kind)
+{
+#ifdef FSTL_INSTRUMENT
+  return counting_allocator(alloc, kind);
+#else
+  (void)kind;
+  return alloc;
+#endif
+}
+
+inline erased_hash_base *instrumented(erased_hash_base *hash, instrument::container kind)
+{
+#ifdef FSTL_INSTRUMENT
+  return counting_hash(hash, kind);
+#else
+  (void)kind;
+  return hash;
+#endif
+}
+
+// The user's hash adapter behind `hash`, for code that needs its concrete type.
+inline erased_hash_base *uninstrumented(erased_hash_base *hash)
+{
+#ifdef FSTL_INSTRUMENT
+  return uncounted_hash(hash);
+#else
+  return hash;
+#endif
+}
+}
+
+#ifdef FSTL_INSTRUMENT
+#define FSTL_INSTRUMENT_ADD(kind, counter, n) \
+  ::fstl::detail::instrument_add(::fstl::instrument::container::kind, &::fstl::instrument::stats::counter, (n))
+#define FSTL_INSTRUMENT_PROBE(kind, length) \
+  ::fstl::detail::instrument_probe(::fstl::instrument::container::kind, (length))
+#else
+#define FSTL_INSTRUMENT_ADD(kind, counter, n) ((void)(n))
+#define FSTL_INSTRUMENT_PROBE(kind, length) ((void)(length))
+#endif
+
+#endif //FSTL_DETAIL_INSTRUMENT_H
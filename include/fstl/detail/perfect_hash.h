@@ -0,0 +1,118 @@
+#pragma once
+
+#ifndef FSTL_PERFECT_HASH_H
+#define FSTL_PERFECT_HASH_H
+
+#include "fstl/functional/hash.h"
+
+// Minimal perfect hashing by hash and displace (as in PTHash). Keys are split by hash into
+// buckets of about six; each bucket gets a 16-bit pilot, searched at build time, that moves
+// all of its keys to free slots. A few slots past the key count keep the last buckets easy to
+// place; the keys that land there are remapped to the holes left below the key count. A
+// lookup is one pilot read, rarely one remap read, and one probe of the element array.
+//
+// Everything here is constexpr so that tables of keys known at compile time can be built by
+// the compiler.
+namespace fstl::detail {
+constexpr size_t phf_max_pilot = 0xffff;
+
+constexpr size_t phf_bucket_count(size_t count) { return count / 6 + 1; }
+constexpr size_t phf_slot_count(size_t count) { return count + count / 64 + 1; }
+
+// Skewed as in PTHash: 60% of the keys go to the first 30% of the buckets. The large buckets
+// are placed first, while the table is mostly empty, which leaves the last small buckets
+// more free slots to choose from. The hash is mixed with the seed first: user hashes may be
+// weak (std::hash is the identity for integers), and a failed seed must not retry the same
+// split of the keys.
+constexpr size_t phf_bucket(size_t hash, size_t seed, size_t buckets)
+{
+  hash = fold_mul(hash ^ seed, 0x9e3779b97f4a7c15ull);
+  size_t dense = buckets * 3 / 10;
+  size_t low = hash & 0xffffffffu;
+  if ((hash >> 32) < 0x99999999u) return (low * dense) >> 32;
+  return dense + ((low * (buckets - dense)) >> 32);
+}
+
+constexpr size_t phf_position(size_t hash, size_t pilot, size_t seed, size_t slots)
+{
+  auto mixed = fold_mul(hash ^ seed ^ (pilot * 0x9e3779b97f4a7c15ull), 0xbf58476d1ce4e5b9ull);
+  return ((mixed & 0xffffffffu) * slots) >> 32;
+}
+
+// Element index in [0, count) of a key with `hash`; only meaningful for the keys built with.
+constexpr size_t phf_index(size_t hash, size_t count, size_t seed, const unsigned short *pilots, const unsigned *remap)
+{
+  auto pos = phf_position(hash, pilots[phf_bucket(hash, seed, phf_bucket_count(count))], seed, phf_slot_count(count));
+  return pos < count ? pos : remap[pos - count];
+}
+
+// Fills pilots[phf_bucket_count(count)] and remap[phf_slot_count(count) - count] for `count`
+// distinct hashes. The caller provides scratch space: bucket_start[phf_bucket_count(count) + 1],
+// bucket_keys[count] and taken[phf_slot_count(count)]. False if some bucket found no pilot,
+// in which case another seed may succeed; equal hashes never do.
+constexpr bool phf_build(const size_t *hashes, size_t count, size_t seed, unsigned short *pilots, unsigned *remap,
+                         unsigned *bucket_start, unsigned *bucket_keys, bool *taken)
+{
+  auto buckets = phf_bucket_count(count);
+  auto slots = phf_slot_count(count);
+
+  // Counting sort of the keys by bucket.
+  for (size_t b = 0; b <= buckets; ++b) bucket_start[b] = 0;
+  for (size_t j = 0; j < count; ++j) ++bucket_start[phf_bucket(hashes[j], seed, buckets) + 1];
+  size_t max_size = 0;
+  for (size_t b = 0; b < buckets; ++b) {
+    max_size = bucket_start[b + 1] > max_size ? bucket_start[b + 1] : max_size;
+    bucket_start[b + 1] += bucket_start[b];
+  }
+  // bucket_start[b] is the insert cursor of bucket b, and ends at the start of bucket b + 1.
+  for (size_t j = 0; j < count; ++j) bucket_keys[bucket_start[phf_bucket(hashes[j], seed, buckets)]++] = static_cast<unsigned>(j);
+  for (size_t b = buckets; b > 0; --b) bucket_start[b] = bucket_start[b - 1];
+  bucket_start[0] = 0;
+
+  for (size_t s = 0; s < slots; ++s) taken[s] = false;
+  for (size_t b = 0; b < buckets; ++b) pilots[b] = 0;
+
+  // Largest buckets first, while most slots are still free.
+  for (size_t size = max_size; size > 0; --size) {
+    for (size_t b = 0; b < buckets; ++b) {
+      auto first = bucket_start[b];
+      if (bucket_start[b + 1] - first != size) continue;
+      // No pilot separates equal hashes.
+      for (size_t j = first; j < first + size; ++j) {
+        for (size_t k = first; k < j; ++k) {
+          if (hashes[bucket_keys[j]] == hashes[bucket_keys[k]]) return false;
+        }
+      }
+      size_t pilot = 0;
+      for (;; ++pilot) {
+        if (pilot > phf_max_pilot) return false;
+        size_t placed = 0;
+        while (placed < size) {
+          auto pos = phf_position(hashes[bucket_keys[first + placed]], pilot, seed, slots);
+          if (taken[pos]) break;
+          taken[pos] = true;
+          ++placed;
+        }
+        if (placed == size) break;
+        while (placed > 0) {
+          --placed;
+          taken[phf_position(hashes[bucket_keys[first + placed]], pilot, seed, slots)] = false;
+        }
+      }
+      pilots[b] = static_cast<unsigned short>(pilot);
+    }
+  }
+
+  // Taken slots past the key count move to the free slots below it, in order.
+  size_t hole = 0;
+  for (size_t s = count; s < slots; ++s) {
+    remap[s - count] = 0;
+    if (!taken[s]) continue;
+    while (taken[hole]) ++hole;
+    remap[s - count] = static_cast<unsigned>(hole++);
+  }
+  return true;
+}
+}
+
+#endif //FSTL_PERFECT_HASH_H
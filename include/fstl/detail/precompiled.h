@@ -0,0 +1,39 @@
+#pragma once
+
+#ifndef FSTL_PRECOMPILED_H
+#define FSTL_PRECOMPILED_H
+
+// The adapters of containers of these types are instantiated once, in the library
+// (src/precompiled.cpp), and declared `extern template` next to their templates: user code
+// then neither instantiates their virtual functions nor emits their vtables. Those of
+// std::string are declared in fstl/string_containers.h, so that the other headers need not
+// include <string>.
+
+// src/precompiled.cpp defines FSTL_EXTERN empty, turning the declarations into definitions.
+#ifndef FSTL_EXTERN
+#define FSTL_EXTERN extern
+#endif
+
+// Element types of vector and forward_list, and key types of hash.
+#define FSTL_PRECOMPILED_TYPES(X) \
+  X(bool) X(char) X(signed char) X(unsigned char) X(wchar_t) X(char16_t) X(char32_t) \
+  X(short) X(unsigned short) X(int) X(unsigned) X(long) X(unsigned long) X(long long) \
+  X(unsigned long long) X(float) X(double) X(long double) \
+  X(void *) X(const void *) X(char *) X(const char *)
+
+// unordered_map key and value types: the integer keys with integer, double and pointer values.
+#define FSTL_PRECOMPILED_KEYS(X, V) \
+  X(int, V) X(unsigned, V) X(long, V) X(unsigned long, V) X(long long, V) X(unsigned long long, V)
+#define FSTL_PRECOMPILED_MAPS(X) \
+  FSTL_PRECOMPILED_KEYS(X, int) FSTL_PRECOMPILED_KEYS(X, unsigned) FSTL_PRECOMPILED_KEYS(X, long) \
+  FSTL_PRECOMPILED_KEYS(X, unsigned long) FSTL_PRECOMPILED_KEYS(X, long long) \
+  FSTL_PRECOMPILED_KEYS(X, unsigned long long) FSTL_PRECOMPILED_KEYS(X, double) FSTL_PRECOMPILED_KEYS(X, void *)
+
+// fstl/string_containers.h: string keys to strings, integers and doubles, and integer keys
+// to strings.
+#define FSTL_PRECOMPILED_STRING_MAPS(X) \
+  X(std::string, std::string) X(std::string, int) X(std::string, unsigned) X(std::string, long) \
+  X(std::string, unsigned long) X(std::string, long long) X(std::string, unsigned long long) \
+  X(std::string, double) FSTL_PRECOMPILED_KEYS(X, std::string)
+
+#endif //FSTL_PRECOMPILED_H
@@ -0,0 +1,25 @@
+#pragma once
+
+#ifndef FSTL_PREFETCH_H
+#define FSTL_PREFETCH_H
+
+#ifdef _MSC_VER
+#include <xmmintrin.h>
+#endif
+
+namespace fstl::detail {
+// Hint that `p` will be read soon; never faults, so it may be given any address.
+inline void prefetch(const void *p)
+{
+#ifdef _MSC_VER
+  _mm_prefetch(static_cast<const char *>(p), _MM_HINT_T0);
+#else
+  __builtin_prefetch(p);
+#endif
+}
+
+// Batched lookups hash and prefetch this many keys ahead of resolving them.
+constexpr unsigned long batch_size = 16;
+}
+
+#endif //FSTL_PREFETCH_H
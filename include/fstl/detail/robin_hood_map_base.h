@@ -0,0 +1,145 @@
+#pragma once
+
+#ifndef FSTL_ROBIN_HOOD_MAP_BASE_H
+#define FSTL_ROBIN_HOOD_MAP_BASE_H
+
+#include "fstl/detail/erased_allocator.h"
+#include "fstl/detail/erased_compare.h"
+#include "fstl/functional/hash.h"
+#include "fstl/hash_table_stats.h"
+#include "fstl/utility.h"
+
+namespace fstl::detail {
+
+struct robin_hood_iterator_base {
+  struct robin_hood_map_base const *m_map = nullptr;
+  size_t m_index = 0;
+
+  void *data() const;
+  robin_hood_iterator_base &next();
+
+  bool operator ==(const robin_hood_iterator_base &other) const { return m_index == other.m_index; }
+  bool operator !=(const robin_hood_iterator_base &other) const { return m_index != other.m_index; }
+};
+
+// Open addressing table with robin hood displacement: an insert takes the slot of any element
+// that is closer to its home slot than the new one would be, so probe lengths stay short and
+// even at load factors of 0.9 and above. Erase shifts the following elements back instead of
+// leaving tombstones. Each slot has a 16-bit tag: its distance from home plus one (0 for an
+// empty slot) and 8 bits of the hash of its key. Probe lengths are capped at
+// min(bucket_count(), max_probe_limit): an insert that would exceed that grows the table, and
+// the table has as many extra slots past its last home slot, so probes never wrap around.
+struct robin_hood_map_base {
+  friend struct robin_hood_iterator_base;
+public:
+  using size_type = unsigned long;
+  using iterator = robin_hood_iterator_base;
+  using emplace_handle = void *;
+
+  static constexpr size_type max_probe_limit = 255;
+
+  robin_hood_map_base(size_type capacity,
+    detail::erased_hash_base *hash,
+    detail::erased_compare_base *key_eq,
+    detail::erased_allocator_base *alloc);
+  robin_hood_map_base(const robin_hood_map_base &other);
+  robin_hood_map_base(robin_hood_map_base &&other) noexcept;
+  robin_hood_map_base &operator=(const robin_hood_map_base &other);
+  robin_hood_map_base &operator=(robin_hood_map_base &&other) noexcept;
+  ~robin_hood_map_base();
+
+  size_type bucket_count() const { return m_capacity; }
+  size_type bucket_size(size_type slot) const;
+
+  float load_factor() const { return m_capacity ? float(m_size) / m_capacity : 0.f; }
+  float max_load_factor() const { return m_max_load_factor; }
+  // Clamped to [0.5, 0.95].
+  void max_load_factor(float ml);
+  void rehash(size_type count);
+  void reserve(size_type count);
+
+  size_type size() const { return m_size; }
+  // Longest probe sequence of any element: the most slots a successful lookup visits. Scans
+  // the tags, so costs O(bucket_count()).
+  size_type max_probe_length() const;
+  // Probe length histogram and hash quality, from the distances kept in the tags: one scan of
+  // the tags without hashing any key.
+  hash_table_stats stats() const;
+
+  void clear();
+
+protected:
+  fstl::pair<iterator, bool> insert_copy(const void *key, const void *pair);
+  // In-place construction: the caller constructs the pair in emplace_data(prepare_emplace())
+  // and commits it. If the key is already present the new pair is destroyed.
+  emplace_handle prepare_emplace();
+  static void *emplace_data(emplace_handle slot) { return slot; }
+  fstl::pair<iterator, bool> commit_emplace(emplace_handle slot);
+
+  void *at(const void *key);
+  void *operator[](const void *key);
+  size_type count(const void *key) const;
+  iterator find(const void *key) const;
+  iterator begin() const;
+  iterator end() const { return {this, m_total}; }
+
+  // Batched lookup of `count` keys laid out `stride` bytes apart: out[j] is the element with
+  // the j-th key, or null. Hashes a group of keys and prefetches their home slots before
+  // resolving any of them, so the cache misses overlap.
+  void find_batch(const void *keys, size_t stride, size_type count, void **out) const;
+  void contains_batch(const void *keys, size_t stride, size_type count, bool *out) const;
+
+  size_type erase(const void *key);
+  iterator erase(iterator pos);
+  // Moves every element of `other` whose key is not present here.
+  void merge(robin_hood_map_base &other);
+  // Transparent lookup: `hash` is the user hash of `key` and `eq` compares it with a stored pair.
+  iterator find(const void *key, size_type hash, erased_key_eq_fn eq) const;
+  erased_hash_base *hasher() const { return m_hash; }
+  erased_compare_base *key_eq() const { return m_equal; }
+  [[noreturn]] static void throw_out_of_range();
+
+private:
+  void *slot(size_type idx) const { return m_slots + idx * m_elem_size; }
+  size_type hash_of(const void *key) const;
+  size_type find_index(const void *key, size_type hash) const;
+  template <class Eq>
+  size_type probe(size_type hash, Eq &&eq) const;
+  // Links the element at `src` (the staging slot, or a slot of another table), relocating it.
+  // Grows the table when the insert would exceed max_probe_limit.
+  size_type place(size_type hash, void *src);
+  bool try_place(size_type hash, void *src, size_type &idx);
+  void relocate(void *dst, void *src) const;
+  void erase_slot(size_type idx);
+  size_type next_full(size_type idx) const;
+  void allocate_table(size_type capacity);
+  void deallocate_table();
+  // Fills `tags` and source[j], the current slot of the element to go to slot j, for a table
+  // of `capacity` home slots. False if some element would pass the probe limit.
+  bool plan_layout(size_type capacity, unsigned short *tags, size_type *source) const;
+  // Moves the elements to a table of `capacity` slots, or more if some element would pass
+  // the probe limit; the staging slot too if `keep_staged`. Throws length_error, leaving the
+  // table unchanged, if the keys have too many equal hashes for any capacity.
+  void resize(size_type capacity, bool keep_staged = false);
+  [[noreturn]] static void throw_too_many_equal_hashes();
+  size_type capacity_for(size_type count) const;
+  void reserve_one(bool keep_staged = false);
+
+  unsigned short *m_tags = nullptr;
+  char *m_slots = nullptr;
+  detail::erased_allocator_base *m_alloc;
+  detail::erased_hash_base *m_hash;
+  detail::erased_compare_base *m_equal;
+  size_t m_elem_size;
+
+  size_type m_size = 0;
+  // Home slots; m_total adds the overflow slots.
+  size_type m_capacity = 0;
+  size_type m_total = 0;
+  size_type m_probe_limit = 0;
+  float m_max_load_factor = 0.9f;
+};
+
+} // end namespace fstl::detail
+
+#endif //FSTL_ROBIN_HOOD_MAP_BASE_H
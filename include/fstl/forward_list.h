@@ -3,13 +3,19 @@
 #ifndef FSTL_FORWARD_LIST_H
 #define FSTL_FORWARD_LIST_H
 
+#ifdef FSTL_USE_STD_LIB
+#include <forward_list>
+namespace fstl {
+  using std::forward_list;
+}
+#else
 #include "fstl/detail/erased_allocator.h"
+#include "fstl/detail/erased_compare.h"
 
 namespace fstl {
 namespace detail {
 
 struct ll_node;
-struct erased_compare_base;
 
 struct forward_list_iterator_base
 {
@@ -29,10 +35,13 @@ struct forward_list_base {
 
 public:
   forward_list_base() = default;
-  explicit forward_list_base(erased_allocator_base *alloc)
-    : m_alloc(alloc) {}
+  explicit forward_list_base(erased_allocator_base *alloc);
 
   explicit forward_list_base(size_type count, erased_allocator_base *alloc);
+  forward_list_base(const forward_list_base &other, erased_allocator_base *alloc);
+  forward_list_base(forward_list_base &&other) noexcept;
+  forward_list_base &operator=(const forward_list_base &) = delete;
+  ~forward_list_base() { clear(); }
 
   void pop_front();
   void erase_after(const_iterator pos);
@@ -41,13 +50,30 @@ public:
 
   void clear();
 protected:
+  // The allocator is not owned by forward_list_base: buckets of unordered_map share one.
   void set_allocator(erased_allocator_base *alloc) { m_alloc = alloc; }
+  erased_allocator_base *allocator() const { return m_alloc; }
   void push_front_copy(const void *val);
   void push_front_move(void *val);
   void push_front_default();
-  void push_front_constructed(void *val);
+  // Two-phase insertion for in-place construction: the caller constructs the element in
+  // node_data(node), then links the node, or releases it with drop_node.
+  ll_node *new_node();
+  static void *node_data(ll_node *node);
+  // Header space that unordered_map uses to keep each element's hash.
+  static size_t node_hash(ll_node *node);
+  static void set_node_hash(ll_node *node, size_t hash);
+  void link_front(ll_node *node);
+  ll_node *unlink_front();
+  // Removes `node` from the list without destroying it.
+  void unlink(ll_node *node);
+  void drop_node(ll_node *node);
+  static void drop_node(ll_node *node, erased_allocator_base *alloc);
   void *front() const;
   iterator find(const void *cmp, erased_compare_base *comparator);
+  // Finds among the nodes whose stored hash is `hash`.
+  iterator find(const void *cmp, size_t hash, erased_compare_base *comparator);
+  iterator find(const void *key, size_t hash, erased_key_eq_fn eq, erased_compare_base *comparator);
   iterator begin() { return {m_first}; }
   iterator end() { return {nullptr}; }
   ll_node *first_node() { return m_first; }
@@ -61,6 +87,7 @@ private:
 template <typename T, typename Allocator = detail::default_allocator<T>>
 class forward_list : public detail::forward_list_base
 {
+  static_assert(alignof(T) <= detail::ll_node_header_size, "forward_list does not support over-aligned types");
   using base = detail::forward_list_base;
 
   struct forward_list_iterator : detail::forward_list_iterator_base
@@ -80,12 +107,41 @@ public:
   using iterator = forward_list_iterator;
 
 public:
-  forward_list() : base(new fstl::detail::erased_allocator(Allocator())) {}
+  forward_list() : base(detail::make_adapter<detail::erased_allocator<Allocator>>(Allocator())) {}
   explicit forward_list(size_type count, Allocator alloc = Allocator())
-    : base(count, new fstl::detail::erased_allocator(alloc)) {}
+    : base(count, detail::make_adapter<detail::erased_allocator<Allocator>>(alloc)) {}
+  forward_list(const forward_list &other) : base(other, other.allocator()->clone()) {}
+  forward_list(forward_list &&other) noexcept = default;
+
+  ~forward_list() {
+    base::clear();
+    detail::release_adapter(base::allocator());
+  }
+
+  forward_list &operator=(const forward_list &other) {
+    if (this != &other) {
+      this->~forward_list();
+      ::new(this) forward_list(other);
+    }
+    return *this;
+  }
+
+  forward_list &operator=(forward_list &&other) noexcept {
+    this->~forward_list();
+    ::new(this) forward_list(static_cast<forward_list &&>(other));
+    return *this;
+  }
 
   void push_front(const T &val) { base::push_front_copy(&val); }
   void push_front(T &&val) { base::push_front_move(&val); }
+
+  template <class ...Args>
+  reference emplace_front(Args &&...args) {
+    auto *node = base::new_node();
+    ::new(base::node_data(node)) value_type{static_cast<Args&&>(args)...};
+    base::link_front(node);
+    return front();
+  }
   reference front() { return *static_cast<pointer>(base::front()); }
   const_reference front() const { return *static_cast<const_pointer>(base::front()); }
 
@@ -93,5 +149,6 @@ public:
   iterator end() { return {nullptr}; }
 };
 } // end namespace fstl
+#endif //FSTL_USE_STD_LIB
 
 #endif //FSTL_FORWARD_LIST_H
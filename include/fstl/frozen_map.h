@@ -0,0 +1,206 @@
+#pragma once
+
+#ifndef FSTL_FROZEN_MAP_H
+#define FSTL_FROZEN_MAP_H
+
+#ifdef FSTL_USE_STD_LIB
+#error "fstl::frozen_map has no standard library counterpart"
+#endif
+
+#include "fstl/detail/perfect_hash.h"
+#include "fstl/unordered_map.h"
+#include "fstl/vector.h"
+
+namespace fstl {
+namespace detail {
+struct frozen_table;
+
+// Elements at the index given by a minimal perfect hash of their key, with the pilots and
+// remap of the hash in the same allocation. Immutable once built.
+class frozen_map_base {
+public:
+  using size_type = unsigned long;
+
+  frozen_map_base(const frozen_map_base &) = delete;
+  frozen_map_base &operator=(const frozen_map_base &) = delete;
+  ~frozen_map_base();
+
+  size_type size() const;
+  bool empty() const { return size() == 0; }
+
+  [[noreturn]] static void throw_out_of_range();
+  [[noreturn]] static void throw_no_perfect_hash();
+
+protected:
+  // Copies count elements with copy(slot, items[j]); items point to pairs whose key is at
+  // offset 0. Of elements with equal keys, the first is kept.
+  frozen_map_base(const void *const *items, size_type count, void (copy)(void *, const void *),
+                  erased_hash_base *hash, erased_compare_base *key_eq, erased_allocator_base *alloc);
+
+  const void *find(const void *key) const;
+  const void *data() const;
+
+private:
+  void destroy(frozen_table *table) const;
+
+  frozen_table *m_table;
+  erased_hash_base *m_hash;
+  erased_compare_base *m_equal;
+  erased_allocator_base *m_alloc;
+};
+
+// Seeds tried before giving up on a key set; each one fails with a tiny probability.
+constexpr size_t phf_max_seed = 64;
+}
+
+// A hash map over a key set fixed at construction, from an unordered_map or a vector of
+// pairs. Every lookup probes exactly one element; the hash adds about 3 bits per key.
+template <typename Key,
+  typename Value,
+  typename Hash = fstl::hash<Key>,
+  typename KeyEqual = fstl::detail::equal_to<Key>,
+  typename Allocator = fstl::detail::default_allocator<fstl::pair<const Key, Value>>
+  >
+class frozen_map : public detail::frozen_map_base
+{
+  static_assert(alignof(fstl::pair<const Key, Value>) <= detail::ll_node_header_size,
+                "frozen_map does not support over-aligned types");
+  using base = detail::frozen_map_base;
+public:
+  using size_type = base::size_type;
+  using value_type = fstl::pair<const Key, Value>;
+  using const_iterator = const value_type *;
+
+  template <class H, class E, class Engine>
+  explicit frozen_map(const unordered_map<Key, Value, H, E, Allocator, Engine> &map,
+                      const Hash &hash = Hash(),
+                      const KeyEqual &equal = KeyEqual(),
+                      const Allocator &alloc = Allocator())
+  : frozen_map(pointers(map), &copy<value_type>, hash, equal, alloc)
+  {
+  }
+
+  explicit frozen_map(const fstl::vector<fstl::pair<Key, Value>> &pairs,
+                      const Hash &hash = Hash(),
+                      const KeyEqual &equal = KeyEqual(),
+                      const Allocator &alloc = Allocator())
+  : frozen_map(pointers(pairs), &copy<fstl::pair<Key, Value>>, hash, equal, alloc)
+  {
+  }
+
+  const Value &at(const Key &key) const {
+    auto *pair = find(key);
+    if (!pair) base::throw_out_of_range();
+    return pair->second;
+  }
+  // The element with `key`, or null.
+  const value_type *find(const Key &key) const { return static_cast<const value_type *>(base::find(&key)); }
+  size_type count(const Key &key) const { return find(key) ? 1 : 0; }
+  bool contains(const Key &key) const { return find(key) != nullptr; }
+
+  // Elements are contiguous, in hash order.
+  const_iterator begin() const { return static_cast<const value_type *>(base::data()); }
+  const_iterator end() const { return begin() + size(); }
+
+private:
+  frozen_map(const fstl::vector<const void *> &items, void (copy)(void *, const void *),
+             const Hash &hash, const KeyEqual &equal, const Allocator &alloc)
+  : base(
+      items.data(), items.size(), copy,
+      detail::make_adapter<detail::erased_hash<Hash>>(hash),
+      detail::make_adapter<detail::erased_key_equal<KeyEqual, Value>>(equal),
+      detail::make_adapter<detail::erased_pair_allocator<Allocator, const Key, Value>>(alloc))
+  {
+  }
+
+  template <class Source>
+  static fstl::vector<const void *> pointers(const Source &source)
+  {
+    fstl::vector<const void *> items;
+    items.reserve(source.size());
+    for (auto &pair : source) items.push_back(&pair);
+    return items;
+  }
+
+  template <class Pair>
+  static void copy(void *slot, const void *pair)
+  {
+    auto &src = *static_cast<const Pair *>(pair);
+    ::new(slot) value_type(src.first, src.second);
+  }
+};
+
+// frozen_map for keys known at compile time, stored inline; built by make_frozen_map, and
+// usable in constant expressions when Key, Value, Hash and KeyEqual are.
+template <typename Key, typename Value, size_t N, typename Hash, typename KeyEqual>
+class static_frozen_map
+{
+public:
+  using size_type = size_t;
+  using value_type = fstl::pair<Key, Value>;
+  using const_iterator = const value_type *;
+
+  constexpr size_type size() const { return N; }
+  constexpr bool empty() const { return N == 0; }
+
+  constexpr const Value &at(const Key &key) const {
+    auto *pair = find(key);
+    if (!pair) detail::frozen_map_base::throw_out_of_range();
+    return pair->second;
+  }
+  constexpr const value_type *find(const Key &key) const {
+    if (N == 0) return nullptr;
+    auto &pair = m_elements[detail::phf_index(m_hash(key), N, m_seed, m_pilots, m_remap)];
+    return m_equal(pair.first, key) ? &pair : nullptr;
+  }
+  constexpr size_type count(const Key &key) const { return find(key) ? 1 : 0; }
+  constexpr bool contains(const Key &key) const { return find(key) != nullptr; }
+
+  constexpr const_iterator begin() const { return m_elements; }
+  constexpr const_iterator end() const { return m_elements + N; }
+
+  // Builds the perfect hash of `pairs`, whose keys must be distinct: when evaluated at
+  // compile time, duplicate keys fail the build.
+  static constexpr static_frozen_map build(const value_type (&pairs)[N], const Hash &hash, const KeyEqual &equal)
+  {
+    static_frozen_map map;
+    map.m_hash = hash;
+    map.m_equal = equal;
+
+    size_t hashes[N ? N : 1] {};
+    unsigned bucket_start[detail::phf_bucket_count(N) + 1] {};
+    unsigned bucket_keys[N ? N : 1] {};
+    bool taken[detail::phf_slot_count(N)] {};
+    for (size_t j = 0; j < N; ++j) hashes[j] = hash(pairs[j].first);
+
+    for (size_t attempt = 0;; ++attempt) {
+      if (attempt == detail::phf_max_seed) detail::frozen_map_base::throw_no_perfect_hash();
+      map.m_seed = detail::hash_int(attempt);
+      if (detail::phf_build(hashes, N, map.m_seed, map.m_pilots, map.m_remap, bucket_start, bucket_keys, taken)) break;
+    }
+    for (size_t j = 0; j < N; ++j) {
+      map.m_elements[detail::phf_index(hashes[j], N, map.m_seed, map.m_pilots, map.m_remap)] = pairs[j];
+    }
+    return map;
+  }
+
+private:
+  value_type m_elements[N ? N : 1] {};
+  unsigned short m_pilots[detail::phf_bucket_count(N)] {};
+  unsigned m_remap[detail::phf_slot_count(N) - N] {};
+  size_t m_seed = 0;
+  Hash m_hash {};
+  KeyEqual m_equal {};
+};
+
+template <typename Key, typename Value, typename Hash = fstl::hash<Key>,
+          typename KeyEqual = fstl::detail::equal_to<Key>, size_t N>
+constexpr static_frozen_map<Key, Value, N, Hash, KeyEqual> make_frozen_map(const fstl::pair<Key, Value> (&pairs)[N],
+                                                                            const Hash &hash = Hash(),
+                                                                            const KeyEqual &equal = KeyEqual())
+{
+  return static_frozen_map<Key, Value, N, Hash, KeyEqual>::build(pairs, hash, equal);
+}
+}
+
+#endif //FSTL_FROZEN_MAP_H
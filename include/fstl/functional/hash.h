@@ -3,26 +3,233 @@
 #ifndef FSTL_FUNCTIONAL_HASH_H
 #define FSTL_FUNCTIONAL_HASH_H
 
+#include "fstl/detail/erased_adapter.h"
+#include "fstl/detail/precompiled.h"
+#include "fstl/type_traits.h"
+
 namespace fstl {
 using size_t = unsigned long;
 
+template <class T> struct hash;
+
+namespace detail {
+// Multiplies to 128 bits and folds the halves together: every input bit reaches every
+// output bit, including the low ones that power-of-two tables index with.
+constexpr unsigned long long fold_mul(unsigned long long a, unsigned long long b)
+{
+#ifdef __SIZEOF_INT128__
+  __uint128_t p = static_cast<__uint128_t>(a) * b;
+  return static_cast<unsigned long long>(p) ^ static_cast<unsigned long long>(p >> 64);
+#else
+  unsigned long long a_lo = a & 0xffffffffu, a_hi = a >> 32, b_lo = b & 0xffffffffu, b_hi = b >> 32;
+  unsigned long long lo_lo = a_lo * b_lo, hi_lo = a_hi * b_lo, lo_hi = a_lo * b_hi, hi_hi = a_hi * b_hi;
+  unsigned long long cross = (lo_lo >> 32) + (hi_lo & 0xffffffffu) + lo_hi;
+  unsigned long long hi = hi_hi + (hi_lo >> 32) + (cross >> 32);
+  unsigned long long lo = (cross << 32) | (lo_lo & 0xffffffffu);
+  return lo ^ hi;
+#endif
+}
+
+// Hash of a word-sized key.
+constexpr size_t hash_int(unsigned long long val)
+{
+  return fold_mul(fold_mul(val ^ 0xa0761d6478bd642full, 0xe7037ed1a0b428dbull), 0x8ebc6af09c88c6e3ull);
+}
+
+constexpr unsigned long long hash_secret[4] = {0xa0761d6478bd642full, 0xe7037ed1a0b428dbull,
+                                               0x8ebc6af09c88c6e3ull, 0x589965cc75374cc3ull};
+
+// Little-endian read of `bytes` (4 or 8) bytes. Byte by byte in constant expressions, a
+// single load otherwise: both give the same value, so tables built at compile time agree
+// with lookups at run time.
+template <class Char>
+constexpr unsigned long long read_le(const Char *p, int bytes)
+{
+  unsigned long long v = 0;
+  if (__builtin_is_constant_evaluated()) {
+    for (int j = 0; j < bytes; ++j) v |= static_cast<unsigned long long>(static_cast<unsigned char>(p[j])) << (8 * j);
+    return v;
+  }
+  if (bytes == 8) {
+    __builtin_memcpy(&v, p, 8);
+  } else {
+    unsigned v32 = 0;
+    __builtin_memcpy(&v32, p, 4);
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    v32 = __builtin_bswap32(v32);
+#endif
+    return v32;
+  }
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+  v = __builtin_bswap64(v);
+#endif
+  return v;
+}
+
+// 64-bit hash of `len` single byte characters (wyhash construction: 128-bit multiply and
+// fold). Usable at compile time, for keys of tables built by constexpr code.
+template <class Char>
+constexpr size_t hash_chars(const Char *p, size_t len, size_t seed = 0)
+{
+  static_assert(sizeof(Char) == 1, "hash_chars reads single byte characters");
+  unsigned long long state = seed ^ fold_mul(seed ^ hash_secret[0], hash_secret[1]);
+  unsigned long long a = 0, b = 0;
+
+  if (len <= 16) {
+    if (len >= 4) {
+      // Two possibly overlapping reads from each end cover 4 to 16 bytes.
+      auto mid = (len >> 3) << 2;
+      a = (read_le(p, 4) << 32) | read_le(p + mid, 4);
+      b = (read_le(p + len - 4, 4) << 32) | read_le(p + len - 4 - mid, 4);
+    } else if (len > 0) {
+      // 1 to 3 bytes: first, middle and last, possibly overlapping.
+      a = (static_cast<unsigned long long>(static_cast<unsigned char>(p[0])) << 16)
+        | (static_cast<unsigned long long>(static_cast<unsigned char>(p[len >> 1])) << 8)
+        | static_cast<unsigned char>(p[len - 1]);
+    }
+  } else {
+    auto left = len;
+    if (left > 48) {
+      // Wide blocks: three independent lanes per 48 bytes keep several multiplies in flight.
+      unsigned long long lane1 = state, lane2 = state;
+      do {
+        state = fold_mul(read_le(p, 8) ^ hash_secret[1], read_le(p + 8, 8) ^ state);
+        lane1 = fold_mul(read_le(p + 16, 8) ^ hash_secret[2], read_le(p + 24, 8) ^ lane1);
+        lane2 = fold_mul(read_le(p + 32, 8) ^ hash_secret[3], read_le(p + 40, 8) ^ lane2);
+        p += 48;
+        left -= 48;
+      } while (left > 48);
+      state ^= lane1 ^ lane2;
+    }
+    while (left > 16) {
+      state = fold_mul(read_le(p, 8) ^ hash_secret[1], read_le(p + 8, 8) ^ state);
+      p += 16;
+      left -= 16;
+    }
+    // The last 16 bytes, overlapping data already consumed if needed.
+    a = read_le(p + left - 16, 8);
+    b = read_le(p + left - 8, 8);
+  }
+
+  return fold_mul(fold_mul(a ^ hash_secret[1], b ^ state) ^ hash_secret[0] ^ len, state ^ hash_secret[1]);
+}
+
+// hash_chars over the bytes of any object.
+size_t hash_bytes(const void *data, size_t len, size_t seed = 0);
+
+template <class T> struct is_floating : false_type {};
+template <> struct is_floating<float> : true_type {};
+template <> struct is_floating<double> : true_type {};
+template <> struct is_floating<long double> : true_type {};
+
+// Floating point keys hash their value, not their bytes: 0.0 and -0.0 compare equal so hash
+// the same, as do all NaNs. An x87 long double hashes its 10 value bytes, not its padding.
+template <class F>
+constexpr size_t hash_float(F val)
+{
+  if (val == 0) return hash_int(0);
+  if (val != val) return hash_int(~0ull);
+  if constexpr (sizeof(F) <= sizeof(unsigned long long)) {
+    unsigned long long word = 0;
+    __builtin_memcpy(&word, &val, sizeof(F));
+    return hash_int(word);
+  } else {
+#if __LDBL_MANT_DIG__ == 64
+    return hash_bytes(&val, 10);
+#else
+    return hash_bytes(&val, sizeof(F));
+#endif
+  }
+}
+
+// Types that convert to an integer word: integers, enums and bool.
+template <class T, class = void>
+struct is_word_convertible : false_type {};
+
+template <class T>
+struct is_word_convertible<T, void_t<decltype(static_cast<unsigned long long>(type_traits_detail::declval<const T &>()))>>
+  : true_type {};
+
+// Containers whose elements are contiguous (strings, string views, vectors).
+template <class T, class = void>
+struct is_string_like : false_type {};
+
+template <class T>
+struct is_string_like<T, void_t<decltype(type_traits_detail::declval<const T &>().data()),
+                                decltype(type_traits_detail::declval<const T &>().size())>> : true_type {};
+}
+
 namespace detail {
-size_t SuperFastHash(const char *data, int len);
+template <class T, bool = is_string_like<T>::value>
+struct hash_base
+{
+  constexpr size_t operator()(const T &val) const
+  {
+    if constexpr (is_floating<T>::value) {
+      return hash_float(val);
+    } else if constexpr (sizeof(T) <= sizeof(unsigned long long) && __has_unique_object_representations(T)
+                         && is_word_convertible<T>::value) {
+      return hash_int(static_cast<unsigned long long>(val));
+    } else if constexpr (sizeof(T) <= sizeof(unsigned long long) && __has_unique_object_representations(T)) {
+      // Pointers and small structs without padding: equal keys have equal bytes.
+      unsigned long long word = 0;
+      __builtin_memcpy(&word, &val, sizeof(T));
+      return hash_int(word);
+    } else {
+      return hash_bytes(&val, sizeof(T));
+    }
+  }
+};
+
+// `len` contiguous elements. Their bytes when equal elements have equal bytes, as characters
+// do; otherwise the hashes of the elements one at a time, since strings, floating point
+// values and padded structs can compare equal with different bytes.
+template <class E>
+constexpr size_t hash_elements(const E *p, size_t len)
+{
+  if constexpr (sizeof(E) == 1 && is_word_convertible<E>::value) {
+    return hash_chars(p, len);
+  } else if constexpr (__has_unique_object_representations(E)) {
+    return hash_bytes(p, len * sizeof(E));
+  } else {
+    unsigned long long state = hash_int(len);
+    for (size_t j = 0; j < len; ++j) state = fold_mul(state ^ hash_secret[0], ::fstl::hash<E>{}(p[j]) ^ hash_secret[1]);
+    return state;
+  }
 }
+
+// Strings hash their characters, so any string-like type or C string with the same
+// characters hashes the same: lookups can use them without building the key type.
 template <class T>
-struct hash
+struct hash_base<T, true>
 {
-  size_t operator()(const T &val)
+  using is_transparent = void;
+
+  template <class S>
+  constexpr size_t operator()(const S &str) const
   {
-    if constexpr (sizeof(T) <= sizeof(size_t))
-      return reinterpret_cast<size_t>(reinterpret_cast<const T *>(val));
-    else
-      return detail::SuperFastHash(reinterpret_cast<const char *>(&val), sizeof(T));
+    if constexpr (is_string_like<S>::value) {
+      return hash_elements(str.data(), str.size());
+    } else {
+      size_t len = 0;
+      while (str[len]) ++len;
+      if constexpr (sizeof(*str) == 1) return hash_chars(str, len);
+      else return hash_bytes(str, len * sizeof(*str));
+    }
   }
 };
+}
+
+template <class T>
+struct hash : detail::hash_base<T> {};
 
 namespace detail {
-struct erased_hash_base { virtual size_t hash(const void * val) = 0; };
+struct erased_hash_base : erased_adapter
+{
+  virtual erased_hash_base *clone() = 0;
+  virtual size_t hash(const void * val) = 0;
+  virtual ~erased_hash_base() {}
+};
 
 template <class T> struct erased_hash;
 
@@ -30,10 +237,18 @@ template<template <class> class Hash, class T>
 struct erased_hash<Hash<T>> : erased_hash_base
 {
   erased_hash(const Hash<T> &hash) : m_hash(hash) {}
+  virtual erased_hash_base *clone() override {
+    if (is_shared()) return this;
+    return new erased_hash{m_hash};
+  }
   virtual size_t hash(const void *val) override { return m_hash(*static_cast<const T *>(val)); }
 
   Hash<T> m_hash;
 };
+
+#define FSTL_EXTERN_HASH(T) FSTL_EXTERN template struct erased_hash<fstl::hash<T>>;
+FSTL_PRECOMPILED_TYPES(FSTL_EXTERN_HASH)
+#undef FSTL_EXTERN_HASH
 }
 
 }
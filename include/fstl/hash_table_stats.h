@@ -0,0 +1,47 @@
+#pragma once
+
+#ifndef FSTL_HASH_TABLE_STATS_H
+#define FSTL_HASH_TABLE_STATS_H
+
+namespace fstl {
+// Shape of a hash table, as returned by unordered_map::stats(): one pass over the table, cheap
+// enough for a periodic metrics export. A "home bucket" is where an element's hash sends it:
+// its bucket with the chained engine, its first probed group of 16 slots with
+// open_addressing, its home slot with robin_hood.
+struct hash_table_stats {
+  static constexpr unsigned long histogram_size = 16;
+
+  unsigned long size = 0;
+  unsigned long bucket_count = 0;
+  float load_factor = 0.f;
+  // Buckets, or slots for the open addressing engines, holding no element.
+  unsigned long empty_buckets = 0;
+  // Heap memory of the table: buckets, slots, control bytes and nodes, but not the memory
+  // that elements own themselves.
+  unsigned long memory_bytes = 0;
+  // Chained engine: length_histogram[j] buckets hold j elements. Open addressing: as many
+  // elements are found after probing j groups (open_addressing) or slots (robin_hood). The
+  // last entry also counts all longer lengths; max_length is the longest.
+  unsigned long length_histogram[histogram_size] = {};
+  unsigned long max_length = 0;
+  // Pearson's chi-square of the number of elements per home bucket against an even spread.
+  // A uniform hash gives about its degrees of freedom, the number of home buckets - 1, so
+  // `uniformity`, their ratio, is near 1; far above 1 means keys cluster on few buckets.
+  double chi_square = 0;
+  double uniformity = 0;
+};
+
+namespace detail {
+// Fills in chi_square and uniformity from the sum of squares of the element counts of
+// `cells` home buckets.
+inline void set_uniformity(hash_table_stats &stats, unsigned long cells, double sum_of_squares)
+{
+  if (stats.size == 0 || cells < 2) return;
+  double expected = double(stats.size) / cells;
+  stats.chi_square = sum_of_squares / expected - double(stats.size);
+  stats.uniformity = stats.chi_square / double(cells - 1);
+}
+}
+}
+
+#endif //FSTL_HASH_TABLE_STATS_H
@@ -0,0 +1,62 @@
+#pragma once
+
+#ifndef FSTL_INSTRUMENT_H
+#define FSTL_INSTRUMENT_H
+
+// Operation counters of the fstl containers, for finding where the memory and time go.
+// Collected only when the library and its users are built with FSTL_INSTRUMENT (the CMake
+// option of the same name); otherwise no container code counts anything and every counter
+// reads as zero.
+namespace fstl::instrument {
+#ifdef FSTL_INSTRUMENT
+inline constexpr bool enabled = true;
+#else
+inline constexpr bool enabled = false;
+#endif
+
+enum class container : unsigned {
+  vector,
+  forward_list,
+  // The chained engine, and the shards of concurrent_unordered_map.
+  unordered_map,
+  flat_map,
+  robin_hood_map,
+  snapshot_map,
+  frozen_map,
+};
+inline constexpr unsigned container_count = 7;
+
+// Totals over every container of one type since startup or the last reset().
+struct stats {
+  unsigned long allocations = 0;
+  unsigned long deallocations = 0;
+  unsigned long allocated_bytes = 0;
+  unsigned long freed_bytes = 0;
+  // Elements moved to a new block of storage: vector growth, open addressing resizes.
+  unsigned long reallocations = 0;
+  // Bucket array or table rebuilt around the existing elements.
+  unsigned long rehashes = 0;
+  unsigned long constructs = 0;
+  // Copies and moves include those done with memcpy for trivial types.
+  unsigned long copies = 0;
+  unsigned long moves = 0;
+  unsigned long destructs = 0;
+  unsigned long hash_calls = 0;
+  // Key lookups, and the length of their probes summed and at most: nodes of the bucket for
+  // the chained engine, control groups for flat_map, slots for robin_hood_map, elements of
+  // the bucket for snapshot_map.
+  unsigned long lookups = 0;
+  unsigned long probes = 0;
+  unsigned long max_probe = 0;
+};
+
+const char *name(container kind);
+stats snapshot(container kind);
+void reset();
+// Writes a table of the counters of every container type that did anything to the file at
+// `path`, or to stderr if null. False if the file could not be written. Instrumented
+// programs report at exit, to the file named by FSTL_INSTRUMENT_REPORT if set.
+bool report(const char *path = nullptr);
+}
+
+#endif //FSTL_INSTRUMENT_H
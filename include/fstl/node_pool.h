@@ -0,0 +1,88 @@
+#pragma once
+
+#ifndef FSTL_NODE_POOL_H
+#define FSTL_NODE_POOL_H
+
+#include <new>
+
+namespace fstl {
+using size_t = unsigned long;
+
+// Hands out fixed-size blocks carved from large slabs, recycling freed blocks through an
+// intrusive free list. Memory goes back to the system only when the pool is destroyed.
+// A pool is not thread safe: containers sharing one must be used from a single thread.
+class node_pool {
+public:
+  explicit node_pool(size_t node_size, size_t nodes_per_slab = 256);
+  node_pool(const node_pool &) = delete;
+  node_pool &operator=(const node_pool &) = delete;
+  ~node_pool();
+
+  void *allocate();
+  void deallocate(void *p);
+
+  size_t node_size() const { return m_node_size; }
+  size_t slab_count() const { return m_slab_count; }
+
+private:
+  void add_slab();
+
+  struct free_node { free_node *next; };
+  struct slab { slab *next; };
+
+  free_node *m_free = nullptr;
+  slab *m_slabs = nullptr;
+  // Uncarved part of the newest slab.
+  char *m_cursor = nullptr;
+  char *m_end = nullptr;
+  size_t m_node_size;
+  size_t m_stride;
+  size_t m_nodes_per_slab;
+  size_t m_slab_count = 0;
+};
+
+// Allocator whose node allocations (forward_list and chained unordered_map nodes) come from a
+// node_pool. By default every container gets a pool of its own, created on first use; pass
+// a pool to share it between containers with the same node size. Requests larger than the
+// pool's node size, and array allocations, go to operator new.
+template <class T>
+struct pool_allocator {
+  using value_type = T;
+  template <class U> struct rebind { using other = pool_allocator<U>; };
+
+  pool_allocator() = default;
+  explicit pool_allocator(node_pool &shared) : m_pool(&shared), m_owned(false) {}
+  // An owned pool is never shared: copies start with a pool of their own.
+  pool_allocator(const pool_allocator &other) : pool_allocator(other, 0) {}
+  template <class U>
+  pool_allocator(const pool_allocator<U> &other) : pool_allocator(other, 0) {}
+  pool_allocator &operator=(const pool_allocator &) = delete;
+  ~pool_allocator() { if (m_owned) delete m_pool; }
+
+  T *allocate(size_t n) { return static_cast<T *>(::operator new(n * sizeof(T))); }
+  void deallocate(T *p, size_t n) { ::operator delete(p, n * sizeof(T)); }
+
+  void *allocate_node(size_t bytes) {
+    if (!m_pool) m_pool = new node_pool(bytes);
+    if (bytes > m_pool->node_size()) return ::operator new(bytes);
+    return m_pool->allocate();
+  }
+  void deallocate_node(void *p, size_t bytes) {
+    if (bytes > m_pool->node_size()) return ::operator delete(p, bytes);
+    m_pool->deallocate(p);
+  }
+
+  node_pool *pool() const { return m_pool; }
+
+private:
+  template <class> friend struct pool_allocator;
+  template <class U>
+  pool_allocator(const pool_allocator<U> &other, int)
+    : m_pool(other.m_owned ? nullptr : other.m_pool), m_owned(other.m_owned) {}
+
+  node_pool *m_pool = nullptr;
+  bool m_owned = true;
+};
+} // end namespace fstl
+
+#endif //FSTL_NODE_POOL_H
@@ -0,0 +1,206 @@
+#pragma once
+
+#ifndef FSTL_SNAPSHOT_MAP_H
+#define FSTL_SNAPSHOT_MAP_H
+
+#ifdef FSTL_USE_STD_LIB
+#error "fstl::snapshot_map has no standard library counterpart"
+#endif
+
+#include "fstl/unordered_map.h"
+#include "fstl/vector.h"
+
+namespace fstl {
+namespace detail {
+struct snapshot_table;
+
+// Immutable hash table in a single allocation: bucket offsets, then the hash of each element,
+// then the elements themselves, grouped by bucket. Lookups only read, so any number of
+// threads may use a snapshot at once.
+class snapshot_map_base {
+public:
+  using size_type = unsigned long;
+
+  snapshot_map_base(const snapshot_map_base &) = delete;
+  snapshot_map_base &operator=(const snapshot_map_base &) = delete;
+  ~snapshot_map_base();
+
+  size_type size() const;
+  bool empty() const { return size() == 0; }
+  size_type bucket_count() const;
+
+protected:
+  // Copies count elements with copy(slot, items[j]); items point to pairs whose key is at
+  // offset 0. Of elements with equal keys, the first is kept.
+  snapshot_map_base(const void *const *items, size_type count, void (copy)(void *, const void *),
+                    erased_hash_base *hash, erased_compare_base *key_eq, erased_allocator_base *alloc);
+
+  const void *find(const void *key) const;
+  const void *data() const;
+  [[noreturn]] static void throw_out_of_range();
+
+private:
+  void destroy(snapshot_table *table) const;
+
+  snapshot_table *m_table;
+  erased_hash_base *m_hash;
+  erased_compare_base *m_equal;
+  erased_allocator_base *m_alloc;
+};
+
+// Reader side of rcu_cell: readers register in one of two sets of counters, chosen by a parity
+// that publishers flip, so a publisher waiting for old readers is not held up by new ones.
+// Each set is spread over per-thread slots, so concurrent readers do not share a cache line.
+class rcu_cell_base {
+public:
+  rcu_cell_base(void *initial, void (destroy)(void *)) : m_current(initial), m_destroy(destroy) {}
+  rcu_cell_base(const rcu_cell_base &) = delete;
+  rcu_cell_base &operator=(const rcu_cell_base &) = delete;
+  ~rcu_cell_base() { if (m_current) m_destroy(m_current); }
+
+protected:
+  // Own cache lines: readers write the counters, while m_current and m_parity are read mostly.
+  struct alignas(64) reader_count { unsigned long count = 0; };
+
+  // Wait-free: two atomic increments and a load. The returned counter is passed to read_unlock.
+  reader_count *read_lock() const
+  {
+    auto parity = __atomic_load_n(&m_parity, __ATOMIC_SEQ_CST);
+    auto *counter = &m_readers[parity][reader_slot()];
+    __atomic_fetch_add(&counter->count, 1, __ATOMIC_SEQ_CST);
+    return counter;
+  }
+  void read_unlock(reader_count *counter) const { __atomic_fetch_sub(&counter->count, 1, __ATOMIC_RELEASE); }
+  void *current() const { return __atomic_load_n(&m_current, __ATOMIC_SEQ_CST); }
+
+  // Swaps in `next` and destroys the previous value once no reader can still see it.
+  // Publishers are serialized; readers are never blocked.
+  void publish(void *next);
+
+private:
+  // Threads are dealt slots round robin; past reader_slots threads, they share.
+  static constexpr unsigned reader_slots = 16;
+  static unsigned next_reader_slot();
+  static unsigned reader_slot()
+  {
+    static thread_local unsigned slot = next_reader_slot();
+    return slot;
+  }
+
+  void *m_current;
+  void (*m_destroy)(void *);
+  unsigned m_parity = 0;
+  bool m_publishing = false;
+  mutable reader_count m_readers[2][reader_slots];
+};
+}
+
+// A hash map frozen at construction, from an unordered_map or a vector of pairs. Lookups
+// are a hash, one bucket range and a scan of its contiguous elements.
+template <typename Key,
+  typename Value,
+  typename Hash = fstl::hash<Key>,
+  typename KeyEqual = fstl::detail::equal_to<Key>,
+  typename Allocator = fstl::detail::default_allocator<fstl::pair<const Key, Value>>
+  >
+class snapshot_map : public detail::snapshot_map_base
+{
+  static_assert(alignof(fstl::pair<const Key, Value>) <= detail::ll_node_header_size,
+                "snapshot_map does not support over-aligned types");
+  using base = detail::snapshot_map_base;
+public:
+  using size_type = base::size_type;
+  using value_type = fstl::pair<const Key, Value>;
+  using const_iterator = const value_type *;
+
+  template <class H, class E, class Engine>
+  explicit snapshot_map(const unordered_map<Key, Value, H, E, Allocator, Engine> &map,
+                        const Hash &hash = Hash(),
+                        const KeyEqual &equal = KeyEqual(),
+                        const Allocator &alloc = Allocator())
+  : snapshot_map(pointers(map), &copy<value_type>, hash, equal, alloc)
+  {
+  }
+
+  explicit snapshot_map(const fstl::vector<fstl::pair<Key, Value>> &pairs,
+                        const Hash &hash = Hash(),
+                        const KeyEqual &equal = KeyEqual(),
+                        const Allocator &alloc = Allocator())
+  : snapshot_map(pointers(pairs), &copy<fstl::pair<Key, Value>>, hash, equal, alloc)
+  {
+  }
+
+  const Value &at(const Key &key) const {
+    auto *pair = find(key);
+    if (!pair) base::throw_out_of_range();
+    return pair->second;
+  }
+  // The element with `key`, or null.
+  const value_type *find(const Key &key) const { return static_cast<const value_type *>(base::find(&key)); }
+  size_type count(const Key &key) const { return find(key) ? 1 : 0; }
+  bool contains(const Key &key) const { return find(key) != nullptr; }
+
+  // Elements are contiguous, in bucket order.
+  const_iterator begin() const { return static_cast<const value_type *>(base::data()); }
+  const_iterator end() const { return begin() + size(); }
+
+private:
+  snapshot_map(const fstl::vector<const void *> &items, void (copy)(void *, const void *),
+               const Hash &hash, const KeyEqual &equal, const Allocator &alloc)
+  : base(
+      items.data(), items.size(), copy,
+      detail::make_adapter<detail::erased_hash<Hash>>(hash),
+      detail::make_adapter<detail::erased_key_equal<KeyEqual, Value>>(equal),
+      detail::make_adapter<detail::erased_pair_allocator<Allocator, const Key, Value>>(alloc))
+  {
+  }
+
+  template <class Source>
+  static fstl::vector<const void *> pointers(const Source &source)
+  {
+    fstl::vector<const void *> items;
+    items.reserve(source.size());
+    for (auto &pair : source) items.push_back(&pair);
+    return items;
+  }
+
+  template <class Pair>
+  static void copy(void *slot, const void *pair)
+  {
+    auto &src = *static_cast<const Pair *>(pair);
+    ::new(slot) value_type(src.first, src.second);
+  }
+};
+
+// Holds the current version of a read-mostly value, such as a snapshot_map. Readers see
+// either the old or the new version while a publisher replaces it, without locking; the old
+// version is destroyed once the last reader that could see it is done.
+template <class T>
+class rcu_cell : detail::rcu_cell_base
+{
+  using base = detail::rcu_cell_base;
+public:
+  explicit rcu_cell(T *initial = nullptr) : base(initial, &destroy) {}
+
+  // Takes ownership of `next`. Blocks until the readers of the previous value are done.
+  void publish(T *next) { base::publish(next); }
+
+  // Calls fn(const T *) with the current value, which stays alive until fn returns; fn must
+  // not keep the pointer, nor publish to this cell.
+  template <class Fn>
+  decltype(auto) read(Fn &&fn) const
+  {
+    struct guard {
+      const rcu_cell &cell;
+      reader_count *counter;
+      ~guard() { cell.read_unlock(counter); }
+    } g{*this, read_lock()};
+    return fn(static_cast<const T *>(current()));
+  }
+
+private:
+  static void destroy(void *value) { delete static_cast<T *>(value); }
+};
+}
+
+#endif //FSTL_SNAPSHOT_MAP_H
@@ -0,0 +1,29 @@
+#pragma once
+
+#ifndef FSTL_STRING_CONTAINERS_H
+#define FSTL_STRING_CONTAINERS_H
+
+// The containers, for use with std::string elements and keys: declares the adapters of
+// vector, forward_list and unordered_map of strings that the library builds, so that code
+// including this header does not instantiate them again.
+#include <string>
+
+#include "fstl/forward_list.h"
+#include "fstl/unordered_map.h"
+#include "fstl/vector.h"
+
+#ifndef FSTL_USE_STD_LIB
+namespace fstl::detail {
+FSTL_EXTERN template struct erased_allocator<default_allocator<std::string>>;
+FSTL_EXTERN template struct erased_hash<fstl::hash<std::string>>;
+
+#define FSTL_EXTERN_MAP(K, V)                                                                   \
+  FSTL_EXTERN template struct erased_key_equal<equal_to<K>, V>;                                 \
+  FSTL_EXTERN template struct erased_allocator<default_allocator<fstl::pair<const K, V>>>;      \
+  FSTL_EXTERN template struct erased_pair_allocator<default_allocator<fstl::pair<const K, V>>, const K, V>;
+FSTL_PRECOMPILED_STRING_MAPS(FSTL_EXTERN_MAP)
+#undef FSTL_EXTERN_MAP
+}
+#endif
+
+#endif //FSTL_STRING_CONTAINERS_H
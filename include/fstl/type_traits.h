@@ -3,6 +3,10 @@
 #ifndef FSTL_TYPE_TRAITS_H
 #define FSTL_TYPE_TRAITS_H
 
+namespace std {
+struct forward_iterator_tag;
+}
+
 namespace fstl {
 
 namespace type_traits_detail {
@@ -12,6 +16,14 @@ template <class T> struct add_reference<T &&> { using lvalue = T &; using rvalue
 
 template<class T>
 typename add_reference<T>::rvalue declval() noexcept;
+
+template <class T> struct remove_const { using type = T; };
+template <class T> struct remove_const<const T> { using type = T; };
+
+struct forward_tag_check {
+  static char test(const std::forward_iterator_tag *);
+  static long test(const void *);
+};
 }
 
 struct false_type { static constexpr bool value = false; };
@@ -31,6 +43,44 @@ struct is_copy_constructible : false_type {};
 template <class T> struct is_copy_constructible<T, void_t<decltype(T(type_traits_detail::declval<const T&>()))>>
   : true_type {};
 
+template <class T, class U> struct is_same : false_type {};
+template <class T> struct is_same<T, T> : true_type {};
+
+// True for pointers and for iterators whose category derives from std::forward_iterator_tag,
+// i.e. ranges that can be walked twice (once to measure, once to copy).
+template <class It, class = void>
+struct is_forward_iterator : false_type {};
+
+template <class It> struct is_forward_iterator<It *> : true_type {};
+
+template <class It>
+struct is_forward_iterator<It, void_t<typename It::iterator_category>> {
+  static constexpr bool value = sizeof(type_traits_detail::forward_tag_check::test(
+    type_traits_detail::declval<typename It::iterator_category *>())) == sizeof(char);
+};
+
+// Iterators that can be measured in constant time with `last - first`.
+template <class It, class = void>
+struct is_random_access_iterator : false_type {};
+
+template <class It>
+struct is_random_access_iterator<It, void_t<decltype(type_traits_detail::declval<It &>() - type_traits_detail::declval<It &>())>>
+  : true_type {};
+
+// Pointers into a contiguous array of (possibly const) T.
+template <class It, class T>
+struct is_contiguous_iterator_of : false_type {};
+
+template <class U, class T>
+struct is_contiguous_iterator_of<U *, T> : is_same<typename type_traits_detail::remove_const<U>::type, T> {};
+
+template <class T>
+struct is_trivially_copyable { static constexpr bool value = __is_trivially_copyable(T); };
+
+// Types whose objects can be moved to a new address with a plain memcpy, without
+// running the move constructor and destructor. Specialize for types known to be safe.
+template <class T>
+struct is_trivially_relocatable : is_trivially_copyable<T> {};
 
 }
 
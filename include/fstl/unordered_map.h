@@ -3,13 +3,29 @@
 #ifndef FSTL_UNORDERED_MAP_H
 #define FSTL_UNORDERED_MAP_H
 
+#ifdef FSTL_USE_STD_LIB
+#include <unordered_map>
+namespace fstl {
+  using std::unordered_map;
+}
+#else
 #include "fstl/detail/erased_allocator.h"
 #include "fstl/detail/erased_compare.h"
+#include "fstl/detail/flat_map_base.h"
+#include "fstl/detail/instrument.h"
+#include "fstl/detail/precompiled.h"
+#include "fstl/detail/robin_hood_map_base.h"
+#include "fstl/forward_list.h"
+#include "fstl/hash_table_stats.h"
 #include "fstl/utility.h"
 #include "fstl/functional/hash.h"
 
 namespace fstl {
 
+// How the chained engine maps a hash to a bucket. A power of two bucket count turns the
+// modulo into a mask but only looks at the low bits of the hash, so it wants a hash that
+// mixes well; a prime bucket count also spreads weak hashes (such as identity) evenly.
+enum class bucket_policy { power_of_two, prime };
 
 namespace detail {
 struct friendly_forward_list_base;
@@ -28,6 +44,11 @@ struct erased_key_equal<KeyEqual<Key>, Value> : erased_compare_base, KeyEqual<Ke
 
   erased_key_equal(const KeyEqual<Key> &ke) : base(ke) {}
 
+  virtual erased_compare_base *clone() override {
+    if (is_shared()) return this;
+    return new erased_key_equal{*this};
+  }
+
   virtual bool compare_eq(const void *a, const void *b) override
   {
     return base::operator()(static_cast<const pair_type *>(a)->first,
@@ -38,7 +59,11 @@ struct erased_key_equal<KeyEqual<Key>, Value> : erased_compare_base, KeyEqual<Ke
 template <typename T>
 struct equal_to
 {
-  bool operator()(const T &lhs, const T &rhs) { return lhs == rhs; }
+  // Any type comparable with T, for lookups without building a T.
+  using is_transparent = void;
+
+  template <class U, class V>
+  constexpr bool operator()(const U &lhs, const V &rhs) const { return lhs == rhs; }
 };
 
 
@@ -48,6 +73,12 @@ struct erased_pair_allocator : erased_allocator<typename Alloc::template rebind<
   using value_type = fstl::pair<First, Second>;
   using base = erased_allocator<typename Alloc::template rebind<fstl::pair<First, Second>>::other>;
   using base::base;
+
+  virtual erased_allocator_base *clone() override {
+    if (this->is_shared()) return this;
+    return new erased_pair_allocator{this->allocator};
+  }
+
   virtual void construct_pair_copy_default(void *pos, const void *first) override
   {
     ::new(pos) value_type{static_cast<const First &>(*static_cast<const First *>(first)),
@@ -55,6 +86,16 @@ struct erased_pair_allocator : erased_allocator<typename Alloc::template rebind<
   }
 };
 
+// Names K when both Hash and KeyEqual accept other key types; SFINAE on K otherwise.
+template <class Hash, class KeyEqual, class K, class = void>
+struct enable_transparent {};
+
+template <class Hash, class KeyEqual, class K>
+struct enable_transparent<Hash, KeyEqual, K, void_t<typename Hash::is_transparent, typename KeyEqual::is_transparent>>
+{
+  using type = K;
+};
+
 struct ll_node;
 
 struct unordered_map_iterator_base {
@@ -69,28 +110,72 @@ struct unordered_map_iterator_base {
   bool operator !=(const unordered_map_iterator_base &other) const { return m_bucket_it != other.m_bucket_it; }
 };
 
+// An element extracted from a chained unordered_map, still in its node. Holds a reference
+// on the allocator adapter the node came from, so it may outlive the map.
+struct node_handle_base {
+  node_handle_base() = default;
+  node_handle_base(ll_node *node, erased_allocator_base *alloc) : m_node(node), m_alloc(alloc) {}
+  node_handle_base(node_handle_base &&other) noexcept;
+  node_handle_base &operator=(node_handle_base &&other) noexcept;
+  ~node_handle_base() { reset(); }
+
+  bool empty() const { return m_node == nullptr; }
+  void *data() const;
+  void reset();
+  // Hands the node over to a map using the same allocator adapter.
+  ll_node *release();
+
+  ll_node *m_node = nullptr;
+  erased_allocator_base *m_alloc = nullptr;
+};
+
 struct unordered_map_base {
   friend struct unordered_map_iterator_base;
+  friend class concurrent_map_base;
 public:
   using size_type = unsigned long;
   using iterator = unordered_map_iterator_base;
+  using emplace_handle = ll_node *;
 
 
   unordered_map_base(size_type num_buckets,
     detail::erased_hash_base *hash,
     detail::erased_compare_base *key_eq,
     detail::erased_allocator_base *alloc);
-
+  unordered_map_base(const unordered_map_base &other);
+  unordered_map_base(unordered_map_base &&other) noexcept;
+  unordered_map_base &operator=(const unordered_map_base &other);
+  unordered_map_base &operator=(unordered_map_base &&other) noexcept;
+  ~unordered_map_base();
 
   size_type bucket_count() const { return m_num_buckets; }
   size_type bucket_size(size_type bucket) const;
 
+  float load_factor() const { return m_num_buckets ? float(m_size) / m_num_buckets : 0.f; }
+  float max_load_factor() const { return m_max_load_factor; }
+  void max_load_factor(float ml);
+  // Sets the bucket count to at least max(count, size() / max_load_factor()), relinking the
+  // existing nodes into the new buckets.
+  void rehash(size_type count);
+  void reserve(size_type count);
+
+  fstl::bucket_policy bucket_policy() const { return m_policy; }
+  void bucket_policy(fstl::bucket_policy policy);
+
   size_type size() const { return m_size; }
+  // Chain length histogram and hash quality. Walks the non-empty buckets: O(size()), plus
+  // O(bucket_count() / 64) to find them.
+  hash_table_stats stats() const;
 
   void clear();
 
 protected:
   fstl::pair<iterator, bool> insert_copy(const void *key, const void *pair);
+  // In-place construction: the caller constructs the pair in emplace_data(prepare_emplace())
+  // and commits it. If the key is already present the new pair is destroyed.
+  emplace_handle prepare_emplace();
+  static void *emplace_data(emplace_handle node);
+  fstl::pair<iterator, bool> commit_emplace(emplace_handle node);
 
   void *at(const void *key);
   void *operator[](const void *key);
@@ -99,34 +184,90 @@ protected:
   iterator begin() const;
   iterator end() const { return {this, nullptr, m_num_buckets}; }
 
+  // Batched lookup of `count` keys laid out `stride` bytes apart: out[j] is the element with
+  // the j-th key, or null. Hashes a group of keys and prefetches their memory before
+  // resolving any of them, so the cache misses overlap.
+  void find_batch(const void *keys, size_t stride, size_type count, void **out) const;
+  void contains_batch(const void *keys, size_t stride, size_type count, bool *out) const;
+
+  size_type erase(const void *key);
+  iterator erase(iterator pos);
+  node_handle_base extract(iterator pos);
+  // Links the handle's node; an element from a node of another allocator is moved into a new
+  // node. The handle keeps its element if the key is already present.
+  fstl::pair<iterator, bool> insert_node(node_handle_base &node);
+  // Relinks every node of `other` whose key is not present here.
+  void merge(unordered_map_base &other);
+  // Transparent lookup: `hash` is the user hash of `key` and `eq` compares it with a stored pair.
+  iterator find(const void *key, size_type hash, erased_key_eq_fn eq) const;
+  erased_hash_base *hasher() const { return m_hash; }
+  erased_compare_base *key_eq() const { return m_equal; }
+  [[noreturn]] static void throw_out_of_range();
+
 private:
+  size_type bucket_index(size_type hash) const {
+    return m_policy == fstl::bucket_policy::power_of_two ? hash & (m_num_buckets - 1) : hash % m_num_buckets;
+  }
+  size_type round_bucket_count(size_type count) const;
+  iterator find(const void *key, size_type hash) const;
+  // Grows the table ahead of an insert that would exceed the maximum load factor.
+  void grow_for(size_type count);
+  // Nodes not yet linked: the element is constructed, or destroyed, by the caller.
+  ll_node *new_node();
+  void drop_node(ll_node *node);
+  iterator link_node(ll_node *node, size_type hash);
+  // The bitmap has one bit per bucket, set while the bucket is not empty, so iteration skips
+  // empty buckets a word at a time and costs O(size()) rather than O(bucket_count()).
+  void mark_occupied(size_type bucket) { m_occupied[bucket / 64] |= 1ull << (bucket % 64); }
+  void mark_empty(size_type bucket) { m_occupied[bucket / 64] &= ~(1ull << (bucket % 64)); }
+  // First non-empty bucket at or after `bucket`, or bucket_count().
+  size_type next_occupied(size_type bucket) const;
 
   detail::friendly_forward_list_base *m_table;
+  unsigned long long *m_occupied;
   detail::erased_allocator_base *m_alloc;
   detail::erased_hash_base *m_hash;
   detail::erased_compare_base *m_equal;
 
   size_type m_size;
   size_type m_num_buckets;
+  float m_max_load_factor = 1.0f;
+  fstl::bucket_policy m_policy = fstl::bucket_policy::power_of_two;
 };
 
 } // end namespace detail
 
+// Storage engines for unordered_map, selected per instantiation.
+// Buckets of individually allocated nodes: references stay valid when the table grows.
+struct chaining { using base = detail::unordered_map_base; };
+// Elements stored inline in a flat slot array probed with control bytes: no allocation per
+// element and far fewer cache misses, but elements move when the table grows.
+struct open_addressing { using base = detail::flat_map_base; };
+// Elements stored inline and kept in robin hood order, with backward shift deletion: the
+// longest probe stays short at load factors up to 0.95 (see max_probe_length()).
+struct robin_hood { using base = detail::robin_hood_map_base; };
+
 template <typename Key,
   typename Value,
   typename Hash = fstl::hash<Key>,
   typename KeyEqual = fstl::detail::equal_to<Key>,
-  typename Allocator = fstl::detail::default_allocator<fstl::pair<const Key, Value>>
+  typename Allocator = fstl::detail::default_allocator<fstl::pair<const Key, Value>>,
+  typename Engine = fstl::chaining
   >
-class unordered_map : public detail::unordered_map_base
+class unordered_map : public Engine::base
 {
-  using base = detail::unordered_map_base;
+  static_assert(alignof(fstl::pair<const Key, Value>) <= detail::ll_node_header_size,
+                "unordered_map does not support over-aligned types");
+  using base = typename Engine::base;
+  template <class K>
+  using transparent_key = typename detail::enable_transparent<Hash, KeyEqual, K>::type;
 public:
+  using size_type = typename base::size_type;
   using key_equal = KeyEqual;
   using value_type = fstl::pair<const Key, Value>;
 
-  class iterator : public detail::unordered_map_iterator_base {
-    using base = unordered_map_iterator_base;
+  class iterator : public base::iterator {
+    using base = typename unordered_map::base::iterator;
   public:
     iterator (const base &b) : base(b) {}
     value_type &operator *() {
@@ -142,8 +283,8 @@ public:
     }
   };
 
-class const_iterator : public detail::unordered_map_iterator_base {
-  using base = unordered_map_iterator_base;
+class const_iterator : public base::iterator {
+  using base = typename unordered_map::base::iterator;
 public:
   const_iterator(const base &b) : base(b) {}
   const value_type &operator*() const {
@@ -160,15 +301,35 @@ public:
   }
 };
 
+  // Owns an element extracted from the map; chaining engine only.
+  class node_type : detail::node_handle_base {
+    friend class unordered_map;
+    node_type(detail::node_handle_base &&handle) : node_handle_base(static_cast<node_handle_base &&>(handle)) {}
+    value_type &pair() const { return *static_cast<value_type *>(node_handle_base::data()); }
+  public:
+    node_type() = default;
+
+    bool empty() const { return node_handle_base::empty(); }
+    explicit operator bool() const { return !empty(); }
+    Key &key() const { return const_cast<Key &>(pair().first); }
+    Value &mapped() const { return pair().second; }
+  };
+
+  struct insert_return_type {
+    iterator position;
+    bool inserted;
+    node_type node;
+  };
+
   explicit unordered_map( size_type bucket_count,
                           const Hash& hash = Hash(),
                           const key_equal& equal = key_equal(),
                           const Allocator& alloc = Allocator() )
-  : unordered_map_base(
+  : base(
       bucket_count,
-      new detail::erased_hash<Hash>(hash),
-      new detail::erased_key_equal<KeyEqual, Value>(equal),
-      new detail::erased_pair_allocator<Allocator, const Key, Value>(alloc))
+      detail::make_adapter<detail::erased_hash<Hash>>(hash),
+      detail::make_adapter<detail::erased_key_equal<KeyEqual, Value>>(equal),
+      detail::make_adapter<detail::erased_pair_allocator<Allocator, const Key, Value>>(alloc))
   {
   }
 
@@ -189,6 +350,27 @@ public:
     return {it, ++it};
   }
 
+  // Heterogeneous lookup, enabled when both Hash and KeyEqual declare is_transparent. Hash
+  // must give equal values for a K and a Key that compare equal.
+  template <class K, class = transparent_key<K>>
+  Value &at(const K &key) {
+    iterator it = transparent_find(key);
+    if (it == end()) base::throw_out_of_range();
+    return it->second;
+  }
+  template <class K, class = transparent_key<K>>
+  Value &operator[](const K &key) {
+    iterator it = transparent_find(key);
+    if (it != end()) return it->second;
+    return emplace(Key(key), Value()).first->second;
+  }
+  template <class K, class = transparent_key<K>>
+  size_type count(const K &key) const { return transparent_find(key) != end() ? 1 : 0; }
+  template <class K, class = transparent_key<K>>
+  iterator find(const K &key) { return transparent_find(key); }
+  template <class K, class = transparent_key<K>>
+  const_iterator find(const K &key) const { return transparent_find(key); }
+
   iterator begin() { return base::begin(); }
   iterator end() { return base::end(); }
 
@@ -201,11 +383,74 @@ public:
   }
 
   template <class ...Args>
-  fstl::pair<iterator, bool> emplace(Args &... args) {
-    return insert(value_type(std::forward<Args>(args)...));
+  fstl::pair<iterator, bool> emplace(Args &&... args) {
+    auto handle = base::prepare_emplace();
+    ::new(base::emplace_data(handle)) value_type(static_cast<Args&&>(args)...);
+    auto [it, ok] = base::commit_emplace(handle);
+    return {iterator{it}, ok};
+  }
+
+  // out[j] points to the element with key keys[j], or is null. Faster than separate finds
+  // when the table does not fit in cache, as the memory accesses of the batch overlap.
+  void find_batch(const Key *keys, size_type count, value_type **out) {
+    base::find_batch(keys, sizeof(Key), count, reinterpret_cast<void **>(out));
+  }
+  void find_batch(const Key *keys, size_type count, const value_type **out) const {
+    base::find_batch(keys, sizeof(Key), count, reinterpret_cast<void **>(const_cast<value_type **>(out)));
+  }
+  void contains_batch(const Key *keys, size_type count, bool *out) const {
+    base::contains_batch(keys, sizeof(Key), count, out);
+  }
+
+  size_type erase(const Key &key) { return base::erase(&key); }
+  iterator erase(iterator pos) { return base::erase(pos); }
+
+  // Node handles move elements between maps without copying them; nodes are relinked when
+  // both maps use the same allocator adapter, as they do for stateless allocators.
+  node_type extract(iterator pos) { return base::extract(pos); }
+  node_type extract(const Key &key) {
+    iterator it = find(key);
+    if (it == end()) return {};
+    return extract(it);
+  }
+  insert_return_type insert(node_type &&node) {
+    auto [it, ok] = base::insert_node(node);
+    return {iterator{it}, ok, static_cast<node_type &&>(node)};
+  }
+
+  template <class H, class E>
+  void merge(unordered_map<Key, Value, H, E, Allocator, Engine> &source) { base::merge(source); }
+  template <class H, class E>
+  void merge(unordered_map<Key, Value, H, E, Allocator, Engine> &&source) { base::merge(source); }
+
+private:
+  template <class K>
+  static bool transparent_eq(detail::erased_compare_base *equal, const void *key, const void *stored) {
+    KeyEqual &eq = *static_cast<detail::erased_key_equal<KeyEqual, Value> *>(equal);
+    return eq(*static_cast<const K *>(key), static_cast<const value_type *>(stored)->first);
+  }
+
+  // The erased adapters only handle Key, so hash and compare in the template.
+  template <class K>
+  typename base::iterator transparent_find(const K &key) const {
+    auto hash = static_cast<detail::erased_hash<Hash> *>(detail::uninstrumented(base::hasher()))->m_hash(key);
+    return base::find(&key, hash, &transparent_eq<K>);
   }
 };
 
+namespace detail {
+// The key comparison and allocators of the default maps of fundamental keys and values,
+// built in the library; their hashes are in fstl/functional/hash.h. fstl/string_containers.h
+// declares those of std::string.
+#define FSTL_EXTERN_MAP(K, V)                                                                   \
+  FSTL_EXTERN template struct erased_key_equal<equal_to<K>, V>;                                 \
+  FSTL_EXTERN template struct erased_allocator<default_allocator<fstl::pair<const K, V>>>;      \
+  FSTL_EXTERN template struct erased_pair_allocator<default_allocator<fstl::pair<const K, V>>, const K, V>;
+FSTL_PRECOMPILED_MAPS(FSTL_EXTERN_MAP)
+#undef FSTL_EXTERN_MAP
+}
+
 } // end namespace fstl
+#endif //FSTL_USE_STD_LIB
 
 #endif //FSTL_UNORDERED_MAP_H
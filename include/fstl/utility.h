@@ -7,7 +7,7 @@ namespace fstl {
 template<class First, class Second>
 struct pair {
   pair() = default;
-  pair(const First &fst, const Second &snd) : first(fst), second(snd) {}
+  constexpr pair(const First &fst, const Second &snd) : first(fst), second(snd) {}
   First first {};
   Second second {};
 };
@@ -10,13 +10,10 @@ namespace fstl {
 }
 #else
 #include "detail/erased_allocator.h"
+#include "fstl/type_traits.h"
 
 #include <initializer_list>
 
-namespace std {
-struct forward_iterator_tag;
-}
-
 namespace fstl
 {
 using detail::erased_allocator_base;
@@ -53,10 +50,11 @@ struct vector_base
   // These are public for implementation purposes, but will be hidden in vector.
   void *data() const { return m_data; }
   erased_allocator_base *get_allocator() const { return m_alloc; }
+  size_type element_size() const { return m_elem_size; }
 
 protected:
-  void *at(size_type pos) const;
-  void *back() const;
+  [[noreturn]] static void throw_out_of_range();
+  void *back() const { return static_cast<char *>(m_data) + (m_size - 1) * m_elem_size; }
   void push_back_copy(const void *val);
   void push_back_move(void *val);
   void assign(size_type count, const void *val);
@@ -65,10 +63,24 @@ protected:
   void *insert_copy(const void *pos, const void *val);
   void *insert_move(const void *pos, void *val);
   void *insert_construct(const void *pos, void *data, void (fn)(void *, void *));
+  // Insert `count` elements at once: `fn` is called on each new slot in order, with `state`.
+  void *insert_construct_n(const void *pos, size_type count, void *state, void (fn)(void *, void *));
+  // Insert copies of the `count` contiguous elements at `src`.
+  void *insert_copy_n(const void *pos, size_type count, const void *src);
   void resize_copy(size_type count, const void *val);
+  // The caller constructed an element in the slot past the end (size() < capacity()).
+  void adopt_back() { ++m_size; }
+  // Reallocates for one more element, constructing it with `fn(slot, state)` before the
+  // existing elements are moved, so `state` may refer to them.
+  void *grow_emplace_back(void *state, void (fn)(void *, void *));
+  bool owns(const void *p) const;
 
 private:
+  char *make_gap(const void *pos, size_type count);
+
   erased_allocator_base *m_alloc;
+  // Cached from m_alloc so that addressing elements needs no virtual call.
+  size_t m_elem_size;
   void *m_data;
   size_t m_capacity;
   size_t m_size;
@@ -144,22 +156,21 @@ public:
     const_iterator m_p;
   };
 
-  vector() : vector_base(new detail::erased_allocator<allocator_type> (Allocator())) {}
+  vector() : vector_base(detail::make_adapter<detail::erased_allocator<allocator_type>>(Allocator())) {}
 
   explicit vector(size_type count, const Allocator &alloc = Allocator() )
-    : vector_base(count, new detail::erased_allocator<allocator_type>(alloc))
+    : vector_base(count, detail::make_adapter<detail::erased_allocator<allocator_type>>(alloc))
   {
   }
 
   vector(size_type count, const T &val, const Allocator &alloc = Allocator())
-    : vector_base(count, &val, new detail::erased_allocator<allocator_type>(alloc)) {}
+    : vector_base(count, &val, detail::make_adapter<detail::erased_allocator<allocator_type>>(alloc)) {}
 
 
   template <class InputIterator, class = decltype(*InputIterator{})>
   vector (InputIterator first, InputIterator last, const Allocator &alloc = Allocator())
-    : vector_base(new detail::erased_allocator<allocator_type> (Allocator()))
+    : vector_base(detail::make_adapter<detail::erased_allocator<allocator_type>>(alloc))
   {
-    reserve(4);
     insert(begin(), first, last);
   }
 
@@ -168,22 +179,30 @@ public:
 
   reference operator[](size_type pos)
   {
-    return *static_cast<pointer>(vector_base::at(pos));
+#ifdef FSTL_HARDENED
+    if (pos >= size()) vector_base::throw_out_of_range();
+#endif
+    return data()[pos];
   }
 
   const_reference operator[](size_type pos) const
   {
-    return *static_cast<const_pointer>(vector_base::at(pos));
+#ifdef FSTL_HARDENED
+    if (pos >= size()) vector_base::throw_out_of_range();
+#endif
+    return data()[pos];
   }
 
   reference at(size_type pos)
   {
-    return *static_cast<pointer>(vector_base::at(pos));
+    if (pos >= size()) vector_base::throw_out_of_range();
+    return data()[pos];
   }
 
   const_reference at(size_type pos) const
   {
-    return *static_cast<const_pointer>(vector_base::at(pos));
+    if (pos >= size()) vector_base::throw_out_of_range();
+    return data()[pos];
   }
 
   // allocator_type get_allocator() const { return allocator_type(); }
@@ -191,18 +210,28 @@ public:
   void push_back(const T &value) { vector_base::push_back_copy(&value); }
   void push_back(T &&value) { vector_base::push_back_move(&value); }
 
-  // We can't create in-place, so the best we can do is move-construct via push_back/insert
   template <typename ...Args>
   reference emplace_back(Args &&...args)
   {
-    push_back(value_type{static_cast<Args&&>(args)...});
+    auto construct = [&](void *slot) { ::new(slot) value_type{static_cast<Args&&>(args)...}; };
+    if (size() == capacity()) {
+      return *static_cast<pointer>(vector_base::grow_emplace_back(&construct, &invoke<decltype(construct)>));
+    }
+    construct(data() + size());
+    vector_base::adopt_back();
     return back();
   }
 
   template <typename ...Args>
   reference emplace(const_iterator pos, Args &&...args)
   {
-    return *insert(pos, value_type{static_cast<Args&&>(args)...});
+    if (pos == end()) return emplace_back(static_cast<Args&&>(args)...);
+    if ((vector_base::owns(&args) || ...)) {
+      // The arguments would be shifted from under us while making room.
+      return *insert(pos, value_type{static_cast<Args&&>(args)...});
+    }
+    auto construct = [&](void *slot) { ::new(slot) value_type{static_cast<Args&&>(args)...}; };
+    return *static_cast<pointer>(vector_base::insert_construct(pos, &construct, &invoke<decltype(construct)>));
   }
 
   void assign(size_type count, const T &value) { vector_base::assign(count, &value); }
@@ -218,18 +247,18 @@ public:
   T &front() { return *static_cast<T *>(vector_base::data()); }
   const T &front() const { return *static_cast<const T *>(vector_base::data()); }
 
-  T &back() { return *static_cast<T *>(vector_base::back()); }
-  const T &back() const { return *static_cast<const T *>(vector_base::back()); }
+  T &back() { return data()[size() - 1]; }
+  const T &back() const { return data()[size() - 1]; }
 
   iterator erase(iterator pos) { return static_cast<T *>(vector_base::erase(pos)); }
   iterator erase(iterator begin, iterator end) { return static_cast<T *>(vector_base::erase(begin, end)); }
 
-  iterator begin() { return static_cast<iterator>(vector_base::data()); }
-  iterator end()   { return static_cast<iterator>(vector_base::back()) + 1; }
-  const_iterator begin() const { return static_cast<const_iterator>(vector_base::data()); }
-  const_iterator end() const   { return static_cast<const_iterator>(vector_base::back()) + 1; }
-  const_iterator cbegin() const { return static_cast<const_iterator>(vector_base::data()); }
-  const_iterator cend() const   { return static_cast<const_iterator>(vector_base::back()) + 1; }
+  iterator begin() { return data(); }
+  iterator end()   { return data() + size(); }
+  const_iterator begin() const { return data(); }
+  const_iterator end() const   { return data() + size(); }
+  const_iterator cbegin() const { return data(); }
+  const_iterator cend() const   { return data() + size(); }
 
   reverse_iterator rbegin() {return end(); }
   reverse_iterator rend() { return begin(); }
@@ -254,20 +283,44 @@ public:
 
   template <class InputIterator>
   iterator insert(const_iterator pos, InputIterator first, InputIterator last) {
-    // FIXME: This is as inefficient as you can get.
-    using it_ptr_type = decltype(&*first);
-    auto constructor = [](void *ptr, void *dataptr) {
-      new(ptr) value_type(*static_cast<it_ptr_type>(dataptr));
-    };
-
-    iterator insert_point = const_cast<iterator>(pos);
-    while (first != last) {
-      insert_point = static_cast<iterator>(vector_base::insert_construct(insert_point, (void *)(&*first), constructor));
-      ++first;
-      // Increment the iterator, otherwise we'll insert backwards.
-      ++insert_point;
+    if constexpr (fstl::is_contiguous_iterator_of<InputIterator, T>::value) {
+      return static_cast<iterator>(vector_base::insert_copy_n(pos, last - first, first));
+    } else if constexpr (fstl::is_forward_iterator<InputIterator>::value) {
+      auto constructor = [](void *ptr, void *state) {
+        auto &it = *static_cast<InputIterator *>(state);
+        new(ptr) value_type(*it);
+        ++it;
+      };
+      return static_cast<iterator>(
+        vector_base::insert_construct_n(pos, distance(first, last), &first, constructor));
+    } else {
+      // Single pass: buffer the range so the tail is still shifted only once.
+      vector buffer;
+      for (; first != last; ++first) buffer.emplace_back(*first);
+      auto constructor = [](void *ptr, void *state) {
+        auto &it = *static_cast<iterator *>(state);
+        new(ptr) value_type(static_cast<value_type &&>(*it));
+        ++it;
+      };
+      iterator buffer_it = buffer.begin();
+      return static_cast<iterator>(
+        vector_base::insert_construct_n(pos, buffer.size(), &buffer_it, constructor));
+    }
+  }
+
+private:
+  template <class Fn>
+  static void invoke(void *slot, void *fn) { (*static_cast<Fn *>(fn))(slot); }
+
+  template <class ForwardIt>
+  static size_type distance(ForwardIt first, ForwardIt last) {
+    if constexpr (fstl::is_random_access_iterator<ForwardIt>::value) {
+      return last - first;
+    } else {
+      size_type n = 0;
+      for (; first != last; ++first) ++n;
+      return n;
     }
-    return insert_point;
   }
 };
 
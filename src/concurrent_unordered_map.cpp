@@ -0,0 +1,121 @@
+#include "fstl/concurrent_unordered_map.h"
+
+#include <mutex>
+#include <new>
+#include <shared_mutex>
+
+namespace fstl::detail {
+// On its own cache lines, so threads locking neighbouring shards do not contend.
+struct alignas(64) concurrent_map_base::shard {
+  shard(erased_hash_base *hash, erased_compare_base *key_eq, erased_allocator_base *alloc)
+    : map(16, hash, key_eq, alloc) {}
+
+  mutable std::shared_mutex lock;
+  unordered_map_base map;
+};
+
+concurrent_map_base::concurrent_map_base(size_type count, erased_hash_base *hash,
+                                         erased_compare_base *key_eq, erased_allocator_base *alloc)
+  : m_shards(nullptr)
+  , m_hash(hash)
+  , m_shard_bits(0)
+{
+  while (shard_count() < count && m_shard_bits < 16) ++m_shard_bits;
+  m_shards = static_cast<shard *>(::operator new(sizeof(shard) << m_shard_bits, std::align_val_t(alignof(shard))));
+  // Shard 0 owns the adapters passed in, the others own clones (or share stateless ones).
+  erased_hash_base *shard_hash = hash;
+  erased_compare_base *shard_equal = key_eq;
+  erased_allocator_base *shard_alloc = alloc;
+  size_type j = 0;
+  try {
+    for (; j < shard_count(); ++j) {
+      if (j > 0) {
+        shard_hash = nullptr;
+        shard_equal = nullptr;
+        shard_alloc = nullptr;
+        shard_hash = hash->clone();
+        shard_equal = key_eq->clone();
+        shard_alloc = alloc->clone();
+      }
+      ::new(&m_shards[j]) shard(shard_hash, shard_equal, shard_alloc);
+    }
+  } catch (...) {
+    // Shard j never took its adapters; shard 0 releases the caller's once destroyed.
+    release_adapter(shard_hash);
+    release_adapter(shard_equal);
+    release_adapter(shard_alloc);
+    while (j > 0) m_shards[--j].~shard();
+    ::operator delete(m_shards, std::align_val_t(alignof(shard)));
+    throw;
+  }
+}
+
+concurrent_map_base::~concurrent_map_base() {
+  for (size_type j = 0; j < shard_count(); ++j) m_shards[j].~shard();
+  ::operator delete(m_shards, std::align_val_t(alignof(shard)));
+}
+
+concurrent_map_base::shard &concurrent_map_base::shard_for(size_type hash) const {
+  // User hashes may be weak (std::hash is the identity for integers, so small keys have no
+  // high bits at all): mix before taking the top bits.
+  hash = fold_mul(hash, 0x9E3779B97F4A7C15ull);
+  return m_shards[m_shard_bits ? hash >> (sizeof(size_type) * 8 - m_shard_bits) : 0];
+}
+
+concurrent_map_base::size_type concurrent_map_base::size() const {
+  size_type total = 0;
+  for (size_type j = 0; j < shard_count(); ++j) {
+    std::shared_lock<std::shared_mutex> guard(m_shards[j].lock);
+    total += m_shards[j].map.size();
+  }
+  return total;
+}
+
+void concurrent_map_base::clear() {
+  for (size_type j = 0; j < shard_count(); ++j) {
+    std::unique_lock<std::shared_mutex> guard(m_shards[j].lock);
+    m_shards[j].map.clear();
+  }
+}
+
+bool concurrent_map_base::insert_or_assign(const void *key, void *construct_state, void (construct)(void *, void *),
+                                           void *assign_state, void (assign)(void *, void *)) {
+  auto hash = m_hash->hash(key);
+  auto &s = shard_for(hash);
+  std::unique_lock<std::shared_mutex> guard(s.lock);
+  auto foundit = s.map.find(key, hash);
+  if (foundit != s.map.end()) {
+    assign(foundit.data(), assign_state);
+    return false;
+  }
+  auto *node = s.map.new_node();
+  try {
+    construct(unordered_map_base::emplace_data(node), construct_state);
+  } catch (...) {
+    s.map.drop_node(node);
+    throw;
+  }
+  s.map.link_node(node, hash);
+  return true;
+}
+
+bool concurrent_map_base::find_and_visit(const void *key, void *state, void (visit)(void *, void *)) const {
+  auto hash = m_hash->hash(key);
+  auto &s = shard_for(hash);
+  std::shared_lock<std::shared_mutex> guard(s.lock);
+  auto foundit = s.map.find(key, hash);
+  if (foundit == s.map.end()) return false;
+  visit(foundit.data(), state);
+  return true;
+}
+
+concurrent_map_base::size_type concurrent_map_base::erase(const void *key) {
+  auto hash = m_hash->hash(key);
+  auto &s = shard_for(hash);
+  std::unique_lock<std::shared_mutex> guard(s.lock);
+  auto foundit = s.map.find(key, hash);
+  if (foundit == s.map.end()) return 0;
+  s.map.erase(foundit);
+  return 1;
+}
+}
@@ -0,0 +1,525 @@
+#include "fstl/detail/flat_map_base.h"
+#include "fstl/detail/instrument.h"
+#include "fstl/detail/prefetch.h"
+#include "fstl/vector.h"
+
+#include <cstring>
+#include <stdexcept>
+#include <stdint.h>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define FSTL_FLAT_MAP_SSE2 1
+#endif
+
+using fstl::detail::flat_map_base,
+      fstl::detail::flat_map_iterator_base;
+using size_type = flat_map_base::size_type;
+
+namespace {
+// Control byte values. Full slots hold the low 7 bits of the hash, so their top bit is clear.
+constexpr signed char EMPTY = -128;   // 0b10000000
+constexpr signed char DELETED = -2;   // 0b11111110
+
+constexpr size_type GROUP_WIDTH = 16;
+
+// Lookups stop at the first group with an empty slot, so keep at least 1/8 of them free.
+size_type max_load(size_type capacity) { return capacity - capacity / 8; }
+
+int lowest_bit(uint32_t mask)
+{
+#ifdef _MSC_VER
+  unsigned long idx;
+  _BitScanForward(&idx, mask);
+  return static_cast<int>(idx);
+#else
+  return __builtin_ctz(mask);
+#endif
+}
+
+// User supplied hashes may be weak (std::hash is the identity for integers), so spread the
+// entropy over all bits before splitting the hash into a probe start (high bits) and a
+// control byte (low 7 bits).
+uint64_t mix(uint64_t h)
+{
+#ifdef __SIZEOF_INT128__
+  __uint128_t p = static_cast<__uint128_t>(h) * 0x9E3779B97F4A7C15ull;
+  return static_cast<uint64_t>(p) ^ static_cast<uint64_t>(p >> 64);
+#else
+  h ^= h >> 33;
+  h *= 0xff51afd7ed558ccdull;
+  return h ^ (h >> 33);
+#endif
+}
+
+signed char h2(size_type hash) { return static_cast<signed char>(hash & 0x7f); }
+
+// The control bytes of GROUP_WIDTH consecutive slots. All the match functions return a mask
+// with bit i set when the i-th byte of the group matches.
+struct group
+{
+#if FSTL_FLAT_MAP_SSE2
+  explicit group(const signed char *ctrl)
+    : m_ctrl(_mm_loadu_si128(reinterpret_cast<const __m128i *>(ctrl))) {}
+
+  uint32_t match(signed char h) const {
+    return _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_set1_epi8(h), m_ctrl));
+  }
+  uint32_t match_empty() const { return match(EMPTY); }
+  uint32_t match_free() const { return _mm_movemask_epi8(m_ctrl); }
+
+  __m128i m_ctrl;
+#else
+  static constexpr uint64_t LSBS = 0x0101010101010101ull;
+  static constexpr uint64_t MSBS = 0x8080808080808080ull;
+
+  explicit group(const signed char *ctrl) : m_lo(load(ctrl)), m_hi(load(ctrl + 8)) {}
+
+  static uint64_t load(const signed char *p) {
+    uint64_t word = 0;
+    for (int j = 0; j < 8; ++j) word |= uint64_t(uint8_t(p[j])) << (8 * j);
+    return word;
+  }
+  // Packs the top bit of every byte into the low 8 bits.
+  static uint32_t gather(uint64_t msbs) { return uint32_t(((msbs >> 7) * 0x0102040810204080ull) >> 56); }
+  uint32_t combine(uint64_t lo, uint64_t hi) const { return gather(lo) | (gather(hi) << 8); }
+
+  // May report false positives next to a real match, which only costs a key comparison.
+  uint32_t match(signed char h) const {
+    uint64_t pattern = LSBS * uint8_t(h);
+    auto zero_bytes = [](uint64_t x) { return (x - LSBS) & ~x & MSBS; };
+    return combine(zero_bytes(m_lo ^ pattern), zero_bytes(m_hi ^ pattern));
+  }
+  uint32_t match_empty() const {
+    // EMPTY is the only value with the top bit set and bit 1 clear.
+    return combine(m_lo & ~(m_lo << 6) & MSBS, m_hi & ~(m_hi << 6) & MSBS);
+  }
+  uint32_t match_free() const { return combine(m_lo & MSBS, m_hi & MSBS); }
+
+  uint64_t m_lo, m_hi;
+#endif
+};
+
+// Triangular probing over groups, which visits every group of a power of two sized table.
+struct probe_seq
+{
+  probe_seq(size_type hash, size_type capacity)
+    : m_mask(capacity / GROUP_WIDTH - 1)
+    , m_group((hash >> 7) & m_mask) {}
+
+  size_type offset() const { return m_group * GROUP_WIDTH; }
+  void next() { m_group = (m_group + ++m_step) & m_mask; }
+
+  size_type m_mask;
+  size_type m_group;
+  size_type m_step = 0;
+};
+
+size_type capacity_for(size_type count)
+{
+  size_type capacity = GROUP_WIDTH;
+  while (max_load(capacity) < count) capacity *= 2;
+  return capacity;
+}
+}
+
+namespace fstl::detail {
+
+flat_map_base::flat_map_base(size_type capacity, erased_hash_base *hash, erased_compare_base *key_eq,
+                             erased_allocator_base *alloc)
+  : m_alloc(instrumented(alloc, instrument::container::flat_map))
+  , m_hash(instrumented(hash, instrument::container::flat_map))
+  , m_equal(key_eq)
+  , m_elem_size(alloc->element_size())
+{
+  if (capacity != 0) allocate_table(capacity_for(capacity));
+}
+
+flat_map_base::flat_map_base(const flat_map_base &other)
+  : m_alloc(other.m_alloc->clone())
+  , m_hash(other.m_hash->clone())
+  , m_equal(other.m_equal->clone())
+  , m_elem_size(other.m_elem_size)
+{
+  if (other.m_capacity == 0) return;
+  allocate_table(other.m_capacity);
+  // Same hash, same capacity: every element goes to the same slot as in `other`.
+  std::memcpy(m_ctrl, other.m_ctrl, m_capacity);
+  if (m_alloc->trivially_copyable()) {
+    std::memcpy(m_slots, other.m_slots, m_capacity * m_elem_size);
+    FSTL_INSTRUMENT_ADD(flat_map, copies, other.m_size);
+  } else {
+    for (size_type j = 0; j < m_capacity; ++j) {
+      if (m_ctrl[j] >= 0) m_alloc->construct_copy(slot(j), other.slot(j));
+    }
+  }
+  m_size = other.m_size;
+  m_growth_left = other.m_growth_left;
+}
+
+flat_map_base::flat_map_base(flat_map_base &&other) noexcept
+  : m_ctrl(other.m_ctrl)
+  , m_slots(other.m_slots)
+  , m_alloc(other.m_alloc)
+  , m_hash(other.m_hash)
+  , m_equal(other.m_equal)
+  , m_elem_size(other.m_elem_size)
+  , m_size(other.m_size)
+  , m_capacity(other.m_capacity)
+  , m_growth_left(other.m_growth_left)
+{
+  // The source stays usable: empty, with adapters of its own (free if stateless).
+  other.m_ctrl = nullptr;
+  other.m_slots = nullptr;
+  other.m_alloc = m_alloc->clone();
+  other.m_hash = m_hash->clone();
+  other.m_equal = m_equal->clone();
+  other.m_size = 0;
+  other.m_capacity = 0;
+  other.m_growth_left = 0;
+}
+
+flat_map_base &flat_map_base::operator=(const flat_map_base &other) {
+  if (this != &other) {
+    this->~flat_map_base();
+    new (this) flat_map_base(other);
+  }
+  return *this;
+}
+
+flat_map_base &flat_map_base::operator=(flat_map_base &&other) noexcept {
+  this->~flat_map_base();
+  new (this) flat_map_base(static_cast<flat_map_base &&>(other));
+  return *this;
+}
+
+flat_map_base::~flat_map_base() {
+  clear();
+  deallocate_table();
+  release_adapter(m_alloc);
+  release_adapter(m_hash);
+  release_adapter(m_equal);
+}
+
+// The slots, one spare slot used to stage emplace, then the control bytes, in one allocation
+// made through the element allocator so that the slots are suitably aligned.
+static size_type allocation_units(size_type capacity, size_type elem_size)
+{
+  return capacity + 1 + (capacity + elem_size - 1) / elem_size;
+}
+
+void flat_map_base::allocate_table(size_type capacity) {
+  m_slots = static_cast<char *>(m_alloc->allocate(allocation_units(capacity, m_elem_size)));
+  m_ctrl = reinterpret_cast<signed char *>(m_slots + (capacity + 1) * m_elem_size);
+  std::memset(m_ctrl, EMPTY, capacity);
+  m_capacity = capacity;
+  m_growth_left = max_load(capacity);
+}
+
+void flat_map_base::deallocate_table() {
+  if (m_slots) m_alloc->deallocate(m_slots, allocation_units(m_capacity, m_elem_size));
+  m_slots = nullptr;
+  m_ctrl = nullptr;
+}
+
+size_type flat_map_base::hash_of(const void *key) const { return mix(m_hash->hash(key)); }
+
+// Index of the full slot on the probe sequence of `hash` for which eq(slot) holds, or
+// m_capacity.
+template <class Eq>
+size_type flat_map_base::probe(size_type hash, Eq &&eq) const {
+  if (m_capacity == 0) return m_capacity;
+  size_type groups = 1;
+  for (probe_seq seq(hash, m_capacity);; seq.next(), ++groups) {
+    group g(m_ctrl + seq.offset());
+    for (auto bits = g.match(h2(hash)); bits != 0; bits &= bits - 1) {
+      auto idx = seq.offset() + lowest_bit(bits);
+      if (eq(slot(idx))) {
+        FSTL_INSTRUMENT_PROBE(flat_map, groups);
+        return idx;
+      }
+    }
+    if (g.match_empty()) {
+      FSTL_INSTRUMENT_PROBE(flat_map, groups);
+      return m_capacity;
+    }
+  }
+}
+
+size_type flat_map_base::find_index(const void *key, size_type hash) const {
+  return probe(hash, [&](const void *stored) { return m_equal->compare_eq(stored, key); });
+}
+
+size_type flat_map_base::find_free(size_type hash) const {
+  for (probe_seq seq(hash, m_capacity);; seq.next()) {
+    if (auto bits = group(m_ctrl + seq.offset()).match_free()) {
+      return seq.offset() + lowest_bit(bits);
+    }
+  }
+}
+
+// Marks a free slot on the probe sequence of `hash` as full and returns it, unconstructed.
+// The caller made sure there is room.
+size_type flat_map_base::claim(size_type hash) {
+  auto idx = find_free(hash);
+  if (m_ctrl[idx] == EMPTY) --m_growth_left;
+  m_ctrl[idx] = h2(hash);
+  ++m_size;
+  return idx;
+}
+
+void flat_map_base::erase_slot(size_type idx) {
+  // Probes stop at the first group with an empty slot, so if this slot's group already has
+  // one no probe runs past it and the slot can become empty rather than a tombstone.
+  if (group(m_ctrl + (idx & ~(GROUP_WIDTH - 1))).match_empty()) {
+    m_ctrl[idx] = EMPTY;
+    ++m_growth_left;
+  } else {
+    m_ctrl[idx] = DELETED;
+  }
+  --m_size;
+}
+
+void flat_map_base::reserve_one(bool keep_staged) {
+  if (m_growth_left != 0) return;
+  // Mostly tombstones: rehashing in place is enough to get rid of them.
+  resize(m_size < max_load(m_capacity) / 2 ? capacity_for(m_size + 1) : capacity_for(m_capacity + 1), keep_staged);
+}
+
+void flat_map_base::relocate(void *dst, void *src) const {
+  if (m_alloc->trivially_relocatable()) {
+    std::memcpy(dst, src, m_elem_size);
+    FSTL_INSTRUMENT_ADD(flat_map, moves, 1);
+  } else {
+    m_alloc->construct_move(dst, src);
+    m_alloc->destruct(src);
+  }
+}
+
+void flat_map_base::resize(size_type capacity, bool keep_staged) {
+  auto *old_ctrl = m_ctrl;
+  auto *old_slots = m_slots;
+  auto old_capacity = m_capacity;
+
+  allocate_table(capacity);
+  if (old_slots) FSTL_INSTRUMENT_ADD(flat_map, rehashes, 1);
+  if (old_slots) FSTL_INSTRUMENT_ADD(flat_map, reallocations, 1);
+  if (keep_staged) relocate(slot(m_capacity), old_slots + old_capacity * m_elem_size);
+  m_size = 0;
+  for (size_type j = 0; j < old_capacity; ++j) {
+    if (old_ctrl[j] < 0) continue;
+    void *old_slot = old_slots + j * m_elem_size;
+    relocate(slot(claim(hash_of(old_slot))), old_slot);
+  }
+  if (old_slots) m_alloc->deallocate(old_slots, allocation_units(old_capacity, m_elem_size));
+}
+
+void flat_map_base::rehash(size_type count) {
+  size_type capacity = GROUP_WIDTH;
+  while (capacity < count) capacity *= 2;
+  auto min_capacity = capacity_for(m_size);
+  if (capacity < min_capacity) capacity = min_capacity;
+  if (capacity != m_capacity) resize(capacity);
+}
+
+void flat_map_base::reserve(size_type count) {
+  auto capacity = capacity_for(count);
+  if (capacity > m_capacity) resize(capacity);
+}
+
+fstl::pair<flat_map_base::iterator, bool> flat_map_base::insert_copy(const void *key, const void *pair) {
+  auto hash = hash_of(key);
+  auto idx = find_index(key, hash);
+  if (idx != m_capacity) {
+    return {{this, idx}, false};
+  }
+  reserve_one();
+  idx = claim(hash);
+  m_alloc->construct_copy(slot(idx), pair);
+  return {{this, idx}, true};
+}
+
+flat_map_base::emplace_handle flat_map_base::prepare_emplace() {
+  // Only an empty table grows before the pair is built: the arguments may refer to elements,
+  // which must not move until then. commit_emplace makes room for the others.
+  if (m_capacity == 0) reserve_one();
+  return slot(m_capacity);
+}
+
+fstl::pair<flat_map_base::iterator, bool> flat_map_base::commit_emplace(emplace_handle staged) {
+  // The key is the first member of the stored pair.
+  auto hash = hash_of(staged);
+  auto idx = find_index(staged, hash);
+  if (idx != m_capacity) {
+    m_alloc->destruct(staged);
+    return {{this, idx}, false};
+  }
+  // A resize carries the staged pair over to the staging slot of the new table.
+  reserve_one(true);
+  idx = claim(hash);
+  relocate(slot(idx), slot(m_capacity));
+  return {{this, idx}, true};
+}
+
+void flat_map_base::find_batch(const void *keys, size_t stride, size_type count, void **out) const {
+  auto *key_bytes = static_cast<const char *>(keys);
+  size_type hashes[batch_size];
+  for (size_type first = 0; first < count; first += batch_size) {
+    auto n = count - first < batch_size ? count - first : batch_size;
+    const char *batch = key_bytes + first * stride;
+    if (m_size == 0) {
+      for (size_type j = 0; j < n; ++j) out[first + j] = nullptr;
+      continue;
+    }
+    // Hash the whole batch, prefetching the first control group of each probe...
+    for (size_type j = 0; j < n; ++j) {
+      hashes[j] = hash_of(batch + j * stride);
+      prefetch(m_ctrl + probe_seq(hashes[j], m_capacity).offset());
+    }
+    // ...then the first slot whose control byte matches...
+    for (size_type j = 0; j < n; ++j) {
+      auto offset = probe_seq(hashes[j], m_capacity).offset();
+      if (auto bits = group(m_ctrl + offset).match(h2(hashes[j]))) prefetch(slot(offset + lowest_bit(bits)));
+    }
+    // ...and only then compare keys.
+    for (size_type j = 0; j < n; ++j) {
+      auto idx = find_index(batch + j * stride, hashes[j]);
+      out[first + j] = idx != m_capacity ? slot(idx) : nullptr;
+    }
+  }
+}
+
+void flat_map_base::contains_batch(const void *keys, size_t stride, size_type count, bool *out) const {
+  void *found[batch_size];
+  auto *key_bytes = static_cast<const char *>(keys);
+  for (size_type first = 0; first < count; first += batch_size) {
+    auto n = count - first < batch_size ? count - first : batch_size;
+    find_batch(key_bytes + first * stride, stride, n, found);
+    for (size_type j = 0; j < n; ++j) out[first + j] = found[j] != nullptr;
+  }
+}
+
+size_type flat_map_base::erase(const void *key) {
+  auto idx = find_index(key, hash_of(key));
+  if (idx == m_capacity) return 0;
+  erase({this, idx});
+  return 1;
+}
+
+flat_map_base::iterator flat_map_base::erase(iterator pos) {
+  m_alloc->destruct(slot(pos.m_index));
+  erase_slot(pos.m_index);
+  return {this, next_full(pos.m_index + 1)};
+}
+
+void flat_map_base::merge(flat_map_base &other) {
+  if (&other == this) return;
+  for (size_type j = 0; j < other.m_capacity; ++j) {
+    if (other.m_ctrl[j] < 0) continue;
+    void *src = other.slot(j);
+    auto hash = hash_of(src);
+    if (find_index(src, hash) != m_capacity) continue;
+    reserve_one();
+    relocate(slot(claim(hash)), src);
+    other.erase_slot(j);
+  }
+}
+
+void flat_map_base::throw_out_of_range() {
+  throw std::out_of_range("unordered_map does not contain key");
+}
+
+void *flat_map_base::at(const void *key) {
+  auto idx = find_index(key, hash_of(key));
+  if (idx != m_capacity) {
+    return slot(idx);
+  }
+  throw_out_of_range();
+}
+
+void *flat_map_base::operator[](const void *key) {
+  auto hash = hash_of(key);
+  auto idx = find_index(key, hash);
+  if (idx != m_capacity) {
+    return slot(idx);
+  }
+  reserve_one();
+  idx = claim(hash);
+  m_alloc->construct_pair_copy_default(slot(idx), key);
+  return slot(idx);
+}
+
+size_type flat_map_base::count(const void *key) const {
+  return find_index(key, hash_of(key)) != m_capacity ? 1 : 0;
+}
+
+flat_map_base::iterator flat_map_base::find(const void *key) const {
+  return {this, find_index(key, hash_of(key))};
+}
+
+flat_map_base::iterator flat_map_base::find(const void *key, size_type hash, erased_key_eq_fn eq) const {
+  return {this, probe(mix(hash), [&](const void *stored) { return eq(m_equal, key, stored); })};
+}
+
+size_type flat_map_base::next_full(size_type idx) const {
+  // A group of control bytes at a time, ignoring the slots before `idx` in the first one.
+  while (idx < m_capacity) {
+    auto offset = idx & ~(GROUP_WIDTH - 1);
+    auto full = ~group(m_ctrl + offset).match_free() & 0xffffu & (~0u << (idx - offset));
+    if (full) return offset + lowest_bit(full);
+    idx = offset + GROUP_WIDTH;
+  }
+  return m_capacity;
+}
+
+flat_map_base::iterator flat_map_base::begin() const { return {this, next_full(0)}; }
+
+size_type flat_map_base::bucket_size(size_type idx) const {
+  return idx < m_capacity && m_ctrl[idx] >= 0 ? 1 : 0;
+}
+
+hash_table_stats flat_map_base::stats() const {
+  hash_table_stats result;
+  result.size = m_size;
+  result.bucket_count = m_capacity;
+  result.load_factor = load_factor();
+  result.empty_buckets = m_capacity - m_size;
+  if (m_capacity == 0) return result;
+  result.memory_bytes = allocation_units(m_capacity, m_elem_size) * m_elem_size;
+
+  fstl::vector<size_type> per_group;
+  per_group.resize(m_capacity / GROUP_WIDTH);
+  for (size_type j = 0; j < m_capacity; ++j) {
+    if (m_ctrl[j] < 0) continue;
+    probe_seq seq(hash_of(slot(j)), m_capacity);
+    ++per_group[seq.m_group];
+    size_type length = 1;
+    for (; seq.offset() != (j & ~(GROUP_WIDTH - 1)); seq.next()) ++length;
+    ++result.length_histogram[length < hash_table_stats::histogram_size ? length : hash_table_stats::histogram_size - 1];
+    if (length > result.max_length) result.max_length = length;
+  }
+  double sum_of_squares = 0;
+  for (auto count : per_group) sum_of_squares += double(count) * count;
+  set_uniformity(result, per_group.size(), sum_of_squares);
+  return result;
+}
+
+void flat_map_base::clear() {
+  if (m_capacity == 0) return;
+  if (!m_alloc->trivially_copyable()) {
+    for (size_type j = 0; j < m_capacity; ++j) {
+      if (m_ctrl[j] >= 0) m_alloc->destruct(slot(j));
+    }
+  }
+  std::memset(m_ctrl, EMPTY, m_capacity);
+  m_size = 0;
+  m_growth_left = max_load(m_capacity);
+}
+
+void *flat_map_iterator_base::data() const { return m_map->slot(m_index); }
+
+flat_map_iterator_base &flat_map_iterator_base::next() {
+  m_index = m_map->next_full(m_index + 1);
+  return *this;
+}
+}
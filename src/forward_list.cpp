@@ -1,16 +1,21 @@
 #include "fstl/forward_list.h"
 #include "fstl/detail/erased_compare.h"
+#include "fstl/detail/instrument.h"
 
-#include <cstdlib>
 #include <fstl/forward_list.h>
 
 
 namespace fstl::detail {
+// The element is stored inline, ll_node_header_size bytes past the start of the node.
 struct ll_node
 {
   ll_node *next = nullptr;
-  void *data = nullptr;
+  // Fits in the header padding; only unordered_map buckets use it.
+  size_t hash = 0;
 };
+static_assert(sizeof(ll_node) <= ll_node_header_size);
+
+static void *payload(ll_node *node) { return reinterpret_cast<char *>(node) + ll_node_header_size; }
 
 forward_list_iterator_base &forward_list_iterator_base::operator ++()
 {
@@ -19,49 +24,77 @@ forward_list_iterator_base &forward_list_iterator_base::operator ++()
 }
 
 
-void *forward_list_iterator_base::operator *() { return m_node->data; }
+void *forward_list_iterator_base::operator *() { return payload(m_node); }
 }
 
 using fstl::detail::ll_node,
       fstl::detail::forward_list_base;
 
 namespace {
+// Header and element share one allocation, which allocate_node aligns to the header size:
+// since the header is padded to that alignment, that covers the element too.
+size_t node_bytes(fstl::detail::erased_allocator_base *alloc)
+{
+  return fstl::detail::ll_node_header_size + alloc->element_size();
+}
+
 ll_node *create(fstl::detail::erased_allocator_base *alloc)
 {
-  ll_node *node = ::new ll_node;
-  node->data = alloc->allocate(1);
-  return node;
+  return ::new(alloc->allocate_node(node_bytes(alloc))) ll_node;
+}
+
+void release(ll_node *node, fstl::detail::erased_allocator_base *alloc)
+{
+  node->~ll_node();
+  alloc->deallocate_node(node, node_bytes(alloc));
 }
 
 void destroy(ll_node *node, fstl::detail::erased_allocator_base *alloc)
 {
-  alloc->destruct(node->data);
-  alloc->deallocate(node->data, 1);
-  node->next = nullptr;
-  delete node;
+  alloc->destruct(fstl::detail::payload(node));
+  release(node, alloc);
 }
 }
 
+forward_list_base::forward_list_base(erased_allocator_base *alloc)
+  : m_alloc(instrumented(alloc, instrument::container::forward_list)) {}
+
 forward_list_base::forward_list_base(size_t count, erased_allocator_base *alloc)
-  : m_alloc(alloc) {
-  auto elem_size = m_alloc->element_size();
-  ll_node *iter = m_first = create(m_alloc);
+  : m_alloc(instrumented(alloc, instrument::container::forward_list)) {
   for (size_t j = 0; j < count; ++j) {
-    iter->next = create(m_alloc);
-    iter = iter->next;
+    push_front_default();
+  }
+}
+
+forward_list_base::forward_list_base(const forward_list_base &other, erased_allocator_base *alloc)
+  : m_alloc(instrumented(alloc, instrument::container::forward_list)) {
+  ll_node **tail = &m_first;
+  for (ll_node *it = other.m_first; it != nullptr; it = it->next) {
+    ll_node *node = create(m_alloc);
+    m_alloc->construct_copy(node_data(node), node_data(it));
+    *tail = node;
+    tail = &node->next;
   }
 }
 
+forward_list_base::forward_list_base(forward_list_base &&other) noexcept
+  : m_first(other.m_first)
+  , m_alloc(other.m_alloc) {
+  // The source stays usable: empty, with an adapter of its own (free if stateless).
+  other.m_first = nullptr;
+  other.m_alloc = m_alloc->clone();
+}
+
 void fstl::detail::forward_list_base::push_front_copy(const void *val) {
   ll_node *new_node = create(m_alloc);
-  m_alloc->construct_copy(new_node->data, val);
+  m_alloc->construct_copy(node_data(new_node), val);
   new_node->next = m_first;
   m_first = new_node;
 }
 
 void fstl::detail::forward_list_base::push_front_move(void *val) {
   ll_node *new_node = create(m_alloc);
-  m_alloc->construct_move(new_node->data, val);
+  m_alloc->construct_move(node_data(new_node), val);
   new_node->next = m_first;
   m_first = new_node;
 }
@@ -69,43 +102,93 @@ void fstl::detail::forward_list_base::push_front_move(void *val) {
 
 void fstl::detail::forward_list_base::push_front_default() {
   ll_node *new_node = create(m_alloc);
-  m_alloc->construct(new_node->data);
+  m_alloc->construct(node_data(new_node));
   new_node->next = m_first;
   m_first = new_node;
 }
 
-void fstl::detail::forward_list_base::push_front_constructed(void *val) {
-  ll_node *new_node = create(m_alloc);
-  new_node->data = val;
-  new_node->next = m_first;
-  m_first = new_node;
+ll_node *fstl::detail::forward_list_base::new_node() { return create(m_alloc); }
+
+void *fstl::detail::forward_list_base::node_data(ll_node *node) { return payload(node); }
+
+fstl::size_t fstl::detail::forward_list_base::node_hash(ll_node *node) { return node->hash; }
+
+void fstl::detail::forward_list_base::set_node_hash(ll_node *node, size_t hash) { node->hash = hash; }
+
+void fstl::detail::forward_list_base::link_front(ll_node *node) {
+  node->next = m_first;
+  m_first = node;
 }
 
+ll_node *fstl::detail::forward_list_base::unlink_front() {
+  ll_node *node = m_first;
+  m_first = node->next;
+  node->next = nullptr;
+  return node;
+}
+
+void fstl::detail::forward_list_base::unlink(ll_node *node) {
+  ll_node **link = &m_first;
+  while (*link != node) link = &(*link)->next;
+  *link = node->next;
+  node->next = nullptr;
+}
+
+void fstl::detail::forward_list_base::drop_node(ll_node *node) { release(node, m_alloc); }
+
+void fstl::detail::forward_list_base::drop_node(ll_node *node, erased_allocator_base *alloc) { release(node, alloc); }
+
 void fstl::detail::forward_list_base::erase_after(forward_list_base::const_iterator pos) {
   ll_node *to_erase = pos.m_node->next;
   pos.m_node->next = to_erase->next;
-  m_alloc->destruct(to_erase->data);
-  to_erase->~ll_node();
-  free(to_erase);
+  destroy(to_erase, m_alloc);
 }
 
 void fstl::detail::forward_list_base::pop_front() {
   auto *old_first = m_first;
   m_first = m_first->next;
-  m_alloc->destruct(old_first->data);
-  old_first->~ll_node();
-  free(old_first);
+  destroy(old_first, m_alloc);
 }
 
-void *fstl::detail::forward_list_base::front() const { return m_first->data; }
+void *fstl::detail::forward_list_base::front() const { return node_data(m_first); }
 
 forward_list_base::iterator
 fstl::detail::forward_list_base::find(const void *cmp, fstl::detail::erased_compare_base *comparator) {
   for (auto *it = m_first; it != nullptr; it = it->next) {
-    if (comparator->compare_eq(it->data, cmp)) {
+    if (comparator->compare_eq(node_data(it), cmp)) {
+      return it;
+    }
+  }
+  return {nullptr};
+}
+
+forward_list_base::iterator
+fstl::detail::forward_list_base::find(const void *cmp, size_t hash, fstl::detail::erased_compare_base *comparator) {
+  // Only call the comparator on a full hash match.
+  size_type nodes = 0;
+  for (auto *it = m_first; it != nullptr; it = it->next) {
+    ++nodes;
+    if (it->hash == hash && comparator->compare_eq(node_data(it), cmp)) {
+      FSTL_INSTRUMENT_PROBE(unordered_map, nodes);
+      return it;
+    }
+  }
+  FSTL_INSTRUMENT_PROBE(unordered_map, nodes);
+  return {nullptr};
+}
+
+forward_list_base::iterator
+fstl::detail::forward_list_base::find(const void *key, size_t hash, erased_key_eq_fn eq,
+                                      fstl::detail::erased_compare_base *comparator) {
+  size_type nodes = 0;
+  for (auto *it = m_first; it != nullptr; it = it->next) {
+    ++nodes;
+    if (it->hash == hash && eq(comparator, key, node_data(it))) {
+      FSTL_INSTRUMENT_PROBE(unordered_map, nodes);
       return it;
     }
   }
+  FSTL_INSTRUMENT_PROBE(unordered_map, nodes);
   return {nullptr};
 }
 
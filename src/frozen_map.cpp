@@ -0,0 +1,149 @@
+#include "fstl/frozen_map.h"
+#include "fstl/detail/instrument.h"
+
+#include <stdexcept>
+
+namespace fstl::detail {
+// Followed in the same allocation by pilots[phf_bucket_count(size)], remap[phf_slot_count(size)
+// - size] and, at elements_offset, the elements in perfect hash order.
+struct frozen_table {
+  using size_type = frozen_map_base::size_type;
+
+  size_type size;
+  size_type seed;
+  size_type elements_offset;
+  size_type bytes;
+
+  unsigned short *pilots() { return reinterpret_cast<unsigned short *>(this + 1); }
+  unsigned *remap() { return reinterpret_cast<unsigned *>(pilots() + round_up(phf_bucket_count(size), 2)); }
+  char *elements() { return reinterpret_cast<char *>(this) + elements_offset; }
+
+  static size_type round_up(size_type n, size_type multiple) { return (n + multiple - 1) / multiple * multiple; }
+};
+
+frozen_map_base::frozen_map_base(const void *const *items, size_type count, void (copy)(void *, const void *),
+                                 erased_hash_base *hash, erased_compare_base *key_eq, erased_allocator_base *alloc)
+  : m_table(nullptr)
+  , m_hash(instrumented(hash, instrument::container::frozen_map))
+  , m_equal(key_eq)
+  , m_alloc(instrumented(alloc, instrument::container::frozen_map))
+{
+  if (count >= (size_type(1) << 31)) throw std::length_error("frozen_map too large");
+
+  // Equal keys can only be told apart by KeyEqual: drop all but the first of each, grouping
+  // the items by their perfect hash bucket to compare only keys with equal hashes.
+  fstl::vector<size_type> all_hashes;
+  all_hashes.reserve(count);
+  for (size_type j = 0; j < count; ++j) all_hashes.push_back(m_hash->hash(items[j]));
+
+  auto buckets = phf_bucket_count(count);
+  fstl::vector<unsigned> bucket_start;
+  fstl::vector<unsigned> bucket_keys;
+  bucket_start.resize(buckets + 1);
+  bucket_keys.resize(count);
+  for (size_type j = 0; j < count; ++j) ++bucket_start[phf_bucket(all_hashes[j], 0, buckets) + 1];
+  for (size_type b = 0; b < buckets; ++b) bucket_start[b + 1] += bucket_start[b];
+  {
+    fstl::vector<unsigned> fill(bucket_start);
+    for (size_type j = 0; j < count; ++j) bucket_keys[fill[phf_bucket(all_hashes[j], 0, buckets)]++] = static_cast<unsigned>(j);
+  }
+  fstl::vector<bool> duplicate;
+  duplicate.resize(count);
+  for (size_type b = 0; b < buckets; ++b) {
+    for (size_type j = bucket_start[b]; j < bucket_start[b + 1]; ++j) {
+      for (size_type k = bucket_start[b]; k < j; ++k) {
+        auto a = bucket_keys[k], c = bucket_keys[j];
+        if (duplicate[a] || all_hashes[a] != all_hashes[c] || !m_equal->compare_eq(items[a], items[c])) continue;
+        // Keep the earlier item in the input.
+        duplicate[a < c ? c : a] = true;
+      }
+    }
+  }
+
+  fstl::vector<const void *> kept_items;
+  fstl::vector<size_type> hashes;
+  for (size_type j = 0; j < count; ++j) {
+    if (duplicate[j]) continue;
+    kept_items.push_back(items[j]);
+    hashes.push_back(all_hashes[j]);
+  }
+  auto size = kept_items.size();
+
+  buckets = phf_bucket_count(size);
+  auto slots = phf_slot_count(size);
+  auto elem_size = m_alloc->element_size();
+  auto header = sizeof(frozen_table) + frozen_table::round_up(buckets, 2) * sizeof(unsigned short)
+                + (slots - size) * sizeof(unsigned);
+  auto elements_offset = frozen_table::round_up(header, ll_node_header_size);
+  auto bytes = elements_offset + size * elem_size;
+
+  auto *table = static_cast<frozen_table *>(m_alloc->allocate_node(bytes));
+  table->size = size;
+  table->elements_offset = elements_offset;
+  table->bytes = bytes;
+
+  bucket_start.resize(buckets + 1);
+  fstl::vector<bool> taken;
+  taken.resize(slots);
+  size_type attempt = 0;
+  for (;; ++attempt) {
+    if (attempt == phf_max_seed) {
+      m_alloc->deallocate_node(table, bytes);
+      throw_no_perfect_hash();
+    }
+    table->seed = hash_int(attempt);
+    if (phf_build(hashes.data(), size, table->seed, table->pilots(), table->remap(),
+                  bucket_start.data(), bucket_keys.data(), taken.data())) break;
+  }
+
+  // Elements are built in index order, so that a throwing copy leaves a prefix to destroy.
+  fstl::vector<const void *> by_index;
+  by_index.resize(size);
+  for (size_type j = 0; j < size; ++j) {
+    by_index[phf_index(hashes[j], size, table->seed, table->pilots(), table->remap())] = kept_items[j];
+  }
+  size_type built = 0;
+  try {
+    for (; built < size; ++built) copy(table->elements() + built * elem_size, by_index[built]);
+  } catch (...) {
+    table->size = built;
+    destroy(table);
+    throw;
+  }
+  m_table = table;
+}
+
+void frozen_map_base::destroy(frozen_table *table) const {
+  auto elem_size = m_alloc->element_size();
+  for (size_type j = 0; j < table->size; ++j) m_alloc->destruct(table->elements() + j * elem_size);
+  m_alloc->deallocate_node(table, table->bytes);
+}
+
+frozen_map_base::~frozen_map_base() {
+  destroy(m_table);
+  release_adapter(m_alloc);
+  release_adapter(m_hash);
+  release_adapter(m_equal);
+}
+
+frozen_map_base::size_type frozen_map_base::size() const { return m_table->size; }
+
+const void *frozen_map_base::find(const void *key) const {
+  if (m_table->size == 0) return nullptr;
+  auto hash = m_hash->hash(key);
+  auto index = phf_index(hash, m_table->size, m_table->seed, m_table->pilots(), m_table->remap());
+  auto *elem = m_table->elements() + index * m_alloc->element_size();
+  FSTL_INSTRUMENT_PROBE(frozen_map, 1);
+  return m_equal->compare_eq(key, elem) ? elem : nullptr;
+}
+
+const void *frozen_map_base::data() const { return m_table->elements(); }
+
+void frozen_map_base::throw_out_of_range() {
+  throw std::out_of_range("frozen_map::at");
+}
+
+void frozen_map_base::throw_no_perfect_hash() {
+  throw std::invalid_argument("frozen_map: no perfect hash found, keys are not distinct or have equal hashes");
+}
+}
@@ -0,0 +1,212 @@
+#include "fstl/detail/instrument.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <map>
+#include <mutex>
+
+namespace fstl::detail {
+instrument_counters instrument_table[instrument::container_count];
+
+void instrument_probe(instrument::container kind, unsigned long length) {
+  auto &stats = instrument_table[unsigned(kind)].stats;
+  __atomic_fetch_add(&stats.lookups, 1, __ATOMIC_RELAXED);
+  __atomic_fetch_add(&stats.probes, length, __ATOMIC_RELAXED);
+  auto longest = __atomic_load_n(&stats.max_probe, __ATOMIC_RELAXED);
+  while (length > longest &&
+         !__atomic_compare_exchange_n(&stats.max_probe, &longest, length, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {}
+}
+
+#ifdef FSTL_INSTRUMENT
+namespace {
+using instrument::container;
+using instrument::stats;
+
+// Forwards to the container's own adapter, which it owns, counting on the way.
+struct counting_allocator_adapter final : erased_allocator_base {
+  counting_allocator_adapter(erased_allocator_base *inner, container kind)
+    : erased_allocator_base(inner->trivially_copyable(), inner->trivially_relocatable())
+    , m_inner(inner)
+    , m_kind(kind) {}
+  ~counting_allocator_adapter() override { release_adapter(m_inner); }
+
+  erased_allocator_base *clone() override {
+    if (is_shared()) return this;
+    return new counting_allocator_adapter(m_inner->clone(), m_kind);
+  }
+
+  void *allocate(size_t n) override {
+    auto *p = m_inner->allocate(n);
+    add(&stats::allocations, 1);
+    add(&stats::allocated_bytes, n * m_inner->element_size());
+    return p;
+  }
+
+  void deallocate(void *p, size_t n) override {
+    add(&stats::deallocations, 1);
+    add(&stats::freed_bytes, n * m_inner->element_size());
+    m_inner->deallocate(p, n);
+  }
+
+  void *allocate_node(size_t bytes) override {
+    auto *p = m_inner->allocate_node(bytes);
+    add(&stats::allocations, 1);
+    add(&stats::allocated_bytes, bytes);
+    return p;
+  }
+
+  void deallocate_node(void *p, size_t bytes) override {
+    add(&stats::deallocations, 1);
+    add(&stats::freed_bytes, bytes);
+    m_inner->deallocate_node(p, bytes);
+  }
+
+  void construct(void *p) override {
+    add(&stats::constructs, 1);
+    m_inner->construct(p);
+  }
+
+  void construct_copy(void *p, const void *val) override {
+    add(&stats::copies, 1);
+    m_inner->construct_copy(p, val);
+  }
+
+  void construct_move(void *p, void *val) override {
+    add(&stats::moves, 1);
+    m_inner->construct_move(p, val);
+  }
+
+  void construct_pair_copy_default(void *pos, const void *first) override {
+    add(&stats::constructs, 1);
+    m_inner->construct_pair_copy_default(pos, first);
+  }
+
+  void destruct(void *p) override {
+    add(&stats::destructs, 1);
+    m_inner->destruct(p);
+  }
+
+  size_t element_size() const override { return m_inner->element_size(); }
+
+  void add(unsigned long stats::*counter, unsigned long n) { instrument_add(m_kind, counter, n); }
+
+  erased_allocator_base *m_inner;
+  container m_kind;
+};
+
+struct counting_hash_adapter final : erased_hash_base {
+  counting_hash_adapter(erased_hash_base *inner, container kind) : m_inner(inner), m_kind(kind) {}
+  ~counting_hash_adapter() override { release_adapter(m_inner); }
+
+  erased_hash_base *clone() override {
+    if (is_shared()) return this;
+    return new counting_hash_adapter(m_inner->clone(), m_kind);
+  }
+
+  size_t hash(const void *val) override {
+    instrument_add(m_kind, &stats::hash_calls, 1);
+    return m_inner->hash(val);
+  }
+
+  erased_hash_base *m_inner;
+  container m_kind;
+};
+
+void report_at_exit() { instrument::report(std::getenv("FSTL_INSTRUMENT_REPORT")); }
+
+const bool report_registered = std::atexit(report_at_exit) == 0;
+}
+
+// Adapters passed on by one base class to another (clones, shards) are counted already.
+// Stateless adapters are shared by every container (see make_adapter), and so are their
+// wrappers: one per adapter and container type, kept for the lifetime of the program.
+template <class Wrapper, class Adapter>
+Adapter *counting(Adapter *inner, instrument::container kind) {
+  if (dynamic_cast<Wrapper *>(inner)) return inner;
+  if (!inner->is_shared()) return new Wrapper(inner, kind);
+
+  static std::mutex lock;
+  static auto *shared = new std::map<std::pair<Adapter *, instrument::container>, Wrapper *>;
+  std::lock_guard<std::mutex> guard(lock);
+  auto &wrapper = (*shared)[{inner, kind}];
+  if (!wrapper) {
+    wrapper = new Wrapper(inner, kind);
+    wrapper->m_shared = true;
+  }
+  return wrapper;
+}
+
+erased_allocator_base *counting_allocator(erased_allocator_base *alloc, instrument::container kind) {
+  return counting<counting_allocator_adapter>(alloc, kind);
+}
+
+erased_hash_base *counting_hash(erased_hash_base *hash, instrument::container kind) {
+  return counting<counting_hash_adapter>(hash, kind);
+}
+
+erased_hash_base *uncounted_hash(erased_hash_base *hash) {
+  auto *counting = dynamic_cast<counting_hash_adapter *>(hash);
+  return counting ? counting->m_inner : hash;
+}
+#endif
+}
+
+namespace fstl::instrument {
+static const char *const names[container_count] = {
+  "vector", "forward_list", "unordered_map", "flat_map", "robin_hood_map", "snapshot_map", "frozen_map",
+};
+
+static const struct { const char *label; unsigned long stats::*counter; } fields[] = {
+  {"allocations", &stats::allocations}, {"deallocations", &stats::deallocations},
+  {"allocated bytes", &stats::allocated_bytes}, {"freed bytes", &stats::freed_bytes},
+  {"reallocations", &stats::reallocations}, {"rehashes", &stats::rehashes},
+  {"constructs", &stats::constructs}, {"copies", &stats::copies}, {"moves", &stats::moves},
+  {"destructs", &stats::destructs}, {"hash calls", &stats::hash_calls}, {"lookups", &stats::lookups},
+  {"probes", &stats::probes}, {"max probe", &stats::max_probe},
+};
+
+const char *name(container kind) { return names[unsigned(kind)]; }
+
+stats snapshot(container kind) {
+  auto &counters = detail::instrument_table[unsigned(kind)].stats;
+  stats result;
+  for (auto &field : fields) result.*field.counter = __atomic_load_n(&(counters.*field.counter), __ATOMIC_RELAXED);
+  return result;
+}
+
+void reset() {
+  for (auto &counters : detail::instrument_table) {
+    for (auto &field : fields) __atomic_store_n(&(counters.stats.*field.counter), 0, __ATOMIC_RELAXED);
+  }
+}
+
+bool report(const char *path) {
+  std::FILE *out = path ? std::fopen(path, "w") : stderr;
+  if (!out) return false;
+
+  // One column per container type that was used.
+  stats columns[container_count];
+  container kinds[container_count];
+  unsigned used = 0;
+  for (unsigned j = 0; j < container_count; ++j) {
+    auto s = snapshot(container(j));
+    if (s.allocations == 0 && s.constructs == 0 && s.copies == 0 && s.moves == 0 && s.hash_calls == 0) continue;
+    kinds[used] = container(j);
+    columns[used++] = s;
+  }
+
+  std::fprintf(out, "%-16s", "fstl counters");
+  for (unsigned j = 0; j < used; ++j) std::fprintf(out, " %15s", name(kinds[j]));
+  std::fprintf(out, "\n");
+  for (auto &field : fields) {
+    std::fprintf(out, "%-16s", field.label);
+    for (unsigned j = 0; j < used; ++j) std::fprintf(out, " %15lu", columns[j].*field.counter);
+    std::fprintf(out, "\n");
+  }
+  if (!used) std::fprintf(out, "(no container was used)\n");
+
+  bool ok = !std::ferror(out);
+  if (path) ok = std::fclose(out) == 0 && ok;
+  return ok;
+}
+}
@@ -0,0 +1,55 @@
+#include "fstl/node_pool.h"
+
+#include <cstddef>
+#include <new>
+
+using fstl::node_pool;
+
+namespace {
+constexpr fstl::size_t max_align = alignof(std::max_align_t);
+
+fstl::size_t round_up(fstl::size_t size) { return (size + max_align - 1) / max_align * max_align; }
+}
+
+node_pool::node_pool(size_t node_size, size_t nodes_per_slab)
+  : m_node_size(node_size)
+  , m_stride(round_up(node_size < sizeof(free_node) ? sizeof(free_node) : node_size))
+  , m_nodes_per_slab(nodes_per_slab ? nodes_per_slab : 1)
+{
+}
+
+node_pool::~node_pool() {
+  auto slab_bytes = round_up(sizeof(slab)) + m_stride * m_nodes_per_slab;
+  while (m_slabs) {
+    auto *next = m_slabs->next;
+    ::operator delete(m_slabs, slab_bytes);
+    m_slabs = next;
+  }
+}
+
+void node_pool::add_slab() {
+  // Each slab starts with the link that chains slabs for the destructor.
+  auto header = round_up(sizeof(slab));
+  auto *memory = static_cast<char *>(::operator new(header + m_stride * m_nodes_per_slab));
+  m_slabs = ::new(memory) slab{m_slabs};
+  m_cursor = memory + header;
+  m_end = m_cursor + m_stride * m_nodes_per_slab;
+  ++m_slab_count;
+}
+
+void *node_pool::allocate() {
+  if (m_free) {
+    auto *node = m_free;
+    m_free = node->next;
+    return node;
+  }
+  // Carve lazily so that a new slab is only touched as far as it is used.
+  if (m_cursor == m_end) add_slab();
+  auto *node = m_cursor;
+  m_cursor += m_stride;
+  return node;
+}
+
+void node_pool::deallocate(void *p) {
+  m_free = ::new(p) free_node{m_free};
+}
@@ -0,0 +1,4 @@
+// Definitions of the adapters that the headers declare extern, see fstl/detail/precompiled.h.
+#define FSTL_EXTERN
+
+#include "fstl/string_containers.h"
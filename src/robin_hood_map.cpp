@@ -0,0 +1,557 @@
+#include "fstl/detail/robin_hood_map_base.h"
+#include "fstl/detail/instrument.h"
+#include "fstl/detail/prefetch.h"
+#include "fstl/vector.h"
+
+#include <cstring>
+#include <stdexcept>
+#include <stdint.h>
+
+using fstl::detail::robin_hood_map_base,
+      fstl::detail::robin_hood_iterator_base;
+using size_type = robin_hood_map_base::size_type;
+
+namespace {
+constexpr size_type MIN_CAPACITY = 16;
+
+// The low byte of a tag is the distance from home plus one, so 0 is an empty slot; the high
+// byte holds the top 8 bits of the hash, which rules out most key comparisons.
+unsigned distance(unsigned short tag) { return tag & 0xff; }
+unsigned short fingerprint(size_type hash) { return static_cast<unsigned short>((hash >> 56) << 8); }
+
+// Same mixing as the flat engine: spread weak user hashes over all bits before splitting
+// them into a home slot (low bits) and a fingerprint (high bits).
+uint64_t mix(uint64_t h)
+{
+#ifdef __SIZEOF_INT128__
+  __uint128_t p = static_cast<__uint128_t>(h) * 0x9E3779B97F4A7C15ull;
+  return static_cast<uint64_t>(p) ^ static_cast<uint64_t>(p >> 64);
+#else
+  h ^= h >> 33;
+  h *= 0xff51afd7ed558ccdull;
+  return h ^ (h >> 33);
+#endif
+}
+
+size_type probe_limit(size_type capacity)
+{
+  return capacity < robin_hood_map_base::max_probe_limit ? capacity : robin_hood_map_base::max_probe_limit;
+}
+
+// Where an element with `hash` goes in a table of `capacity` home slots and `total` slots in
+// all: the slot `pos` of the first element closer to its home than it, at distance `dist`
+// from its home, and the first empty slot `last` from there, up to which the elements shift
+// one slot further. False if that would take some element past the probe limit.
+bool find_place(const unsigned short *tags, size_type capacity, size_type total, size_type hash,
+                size_type &pos, size_type &last, unsigned &dist)
+{
+  auto limit = probe_limit(capacity);
+  pos = hash & (capacity - 1);
+  dist = 1;
+  for (; distance(tags[pos]) >= dist; ++pos, ++dist) {
+    if (dist == limit) return false;
+  }
+  last = pos;
+  for (; tags[last] != 0; ++last) {
+    if (distance(tags[last]) == limit || last + 1 == total) return false;
+  }
+  return true;
+}
+}
+
+namespace fstl::detail {
+
+robin_hood_map_base::robin_hood_map_base(size_type capacity, erased_hash_base *hash, erased_compare_base *key_eq,
+                                         erased_allocator_base *alloc)
+  : m_alloc(instrumented(alloc, instrument::container::robin_hood_map))
+  , m_hash(instrumented(hash, instrument::container::robin_hood_map))
+  , m_equal(key_eq)
+  , m_elem_size(alloc->element_size())
+{
+  if (capacity != 0) allocate_table(capacity_for(capacity));
+}
+
+robin_hood_map_base::robin_hood_map_base(const robin_hood_map_base &other)
+  : m_alloc(other.m_alloc->clone())
+  , m_hash(other.m_hash->clone())
+  , m_equal(other.m_equal->clone())
+  , m_elem_size(other.m_elem_size)
+  , m_max_load_factor(other.m_max_load_factor)
+{
+  if (other.m_capacity == 0) return;
+  allocate_table(other.m_capacity);
+  // Same hash, same capacity: every element goes to the same slot as in `other`.
+  std::memcpy(m_tags, other.m_tags, m_total * sizeof(*m_tags));
+  if (m_alloc->trivially_copyable()) {
+    std::memcpy(m_slots, other.m_slots, m_total * m_elem_size);
+    FSTL_INSTRUMENT_ADD(robin_hood_map, copies, other.m_size);
+  } else {
+    for (size_type j = 0; j < m_total; ++j) {
+      if (m_tags[j] != 0) m_alloc->construct_copy(slot(j), other.slot(j));
+    }
+  }
+  m_size = other.m_size;
+}
+
+robin_hood_map_base::robin_hood_map_base(robin_hood_map_base &&other) noexcept
+  : m_tags(other.m_tags)
+  , m_slots(other.m_slots)
+  , m_alloc(other.m_alloc)
+  , m_hash(other.m_hash)
+  , m_equal(other.m_equal)
+  , m_elem_size(other.m_elem_size)
+  , m_size(other.m_size)
+  , m_capacity(other.m_capacity)
+  , m_total(other.m_total)
+  , m_probe_limit(other.m_probe_limit)
+  , m_max_load_factor(other.m_max_load_factor)
+{
+  // The source stays usable: empty, with adapters of its own (free if stateless).
+  other.m_tags = nullptr;
+  other.m_slots = nullptr;
+  other.m_alloc = m_alloc->clone();
+  other.m_hash = m_hash->clone();
+  other.m_equal = m_equal->clone();
+  other.m_size = 0;
+  other.m_capacity = 0;
+  other.m_total = 0;
+  other.m_probe_limit = 0;
+}
+
+robin_hood_map_base &robin_hood_map_base::operator=(const robin_hood_map_base &other) {
+  if (this != &other) {
+    this->~robin_hood_map_base();
+    new (this) robin_hood_map_base(other);
+  }
+  return *this;
+}
+
+robin_hood_map_base &robin_hood_map_base::operator=(robin_hood_map_base &&other) noexcept {
+  this->~robin_hood_map_base();
+  new (this) robin_hood_map_base(static_cast<robin_hood_map_base &&>(other));
+  return *this;
+}
+
+robin_hood_map_base::~robin_hood_map_base() {
+  clear();
+  deallocate_table();
+  release_adapter(m_alloc);
+  release_adapter(m_hash);
+  release_adapter(m_equal);
+}
+
+// The slots, one spare slot used to stage emplace, then the tags, in one allocation made
+// through the element allocator so that the slots are suitably aligned.
+static size_type allocation_units(size_type total, size_type elem_size)
+{
+  return total + 1 + (total * sizeof(unsigned short) + elem_size - 1) / elem_size;
+}
+
+void robin_hood_map_base::allocate_table(size_type capacity) {
+  auto total = capacity + probe_limit(capacity);
+  m_slots = static_cast<char *>(m_alloc->allocate(allocation_units(total, m_elem_size)));
+  m_tags = reinterpret_cast<unsigned short *>(m_slots + (total + 1) * m_elem_size);
+  std::memset(m_tags, 0, total * sizeof(*m_tags));
+  m_capacity = capacity;
+  m_probe_limit = probe_limit(capacity);
+  m_total = total;
+}
+
+void robin_hood_map_base::deallocate_table() {
+  if (m_slots) m_alloc->deallocate(m_slots, allocation_units(m_total, m_elem_size));
+  m_slots = nullptr;
+  m_tags = nullptr;
+}
+
+size_type robin_hood_map_base::hash_of(const void *key) const { return mix(m_hash->hash(key)); }
+
+// Index of the slot on the probe sequence of `hash` for which eq(slot) holds, or m_total. The
+// elements of a probe sequence are ordered by distance from home, so the lookup stops at the
+// first slot whose element is closer to its home than the key would be.
+template <class Eq>
+size_type robin_hood_map_base::probe(size_type hash, Eq &&eq) const {
+  if (m_size == 0) return m_total;
+  auto idx = hash & (m_capacity - 1);
+  auto fp = fingerprint(hash);
+  for (unsigned dist = 1;; ++dist, ++idx) {
+    auto tag = m_tags[idx];
+    if (distance(tag) < dist) {
+      FSTL_INSTRUMENT_PROBE(robin_hood_map, dist);
+      return m_total;
+    }
+    if (tag == (fp | dist) && eq(slot(idx))) {
+      FSTL_INSTRUMENT_PROBE(robin_hood_map, dist);
+      return idx;
+    }
+  }
+}
+
+size_type robin_hood_map_base::find_index(const void *key, size_type hash) const {
+  return probe(hash, [&](const void *stored) { return m_equal->compare_eq(stored, key); });
+}
+
+void robin_hood_map_base::relocate(void *dst, void *src) const {
+  if (m_alloc->trivially_relocatable()) {
+    std::memcpy(dst, src, m_elem_size);
+    FSTL_INSTRUMENT_ADD(robin_hood_map, moves, 1);
+  } else {
+    m_alloc->construct_move(dst, src);
+    m_alloc->destruct(src);
+  }
+}
+
+// Inserts the element at `src`, which is not in the table, into the slot of the first element
+// closer to its home than it, shifting the run of elements from there up to the next empty
+// slot one slot further. False, leaving the table untouched, if that would take some
+// element past the probe limit.
+bool robin_hood_map_base::try_place(size_type hash, void *src, size_type &idx) {
+  size_type pos, last;
+  unsigned dist;
+  if (!find_place(m_tags, m_capacity, m_total, hash, pos, last, dist)) return false;
+  for (auto j = last; j != pos; --j) m_tags[j] = m_tags[j - 1] + 1;
+  if (m_alloc->trivially_relocatable()) {
+    std::memmove(slot(pos + 1), slot(pos), (last - pos) * m_elem_size);
+    FSTL_INSTRUMENT_ADD(robin_hood_map, moves, last - pos);
+  } else {
+    for (; last != pos; --last) relocate(slot(last), slot(last - 1));
+  }
+  relocate(slot(pos), src);
+  m_tags[pos] = fingerprint(hash) | dist;
+  ++m_size;
+  idx = pos;
+  return true;
+}
+
+size_type robin_hood_map_base::place(size_type hash, void *src) {
+  size_type idx;
+  while (!try_place(hash, src, idx)) {
+    // A mostly empty table that overflows will not do better when grown, see resize().
+    if (m_size < m_capacity / 8) throw_too_many_equal_hashes();
+    bool staged = src == slot(m_total);
+    resize(m_capacity * 2, staged);
+    if (staged) src = slot(m_total);
+  }
+  return idx;
+}
+
+void robin_hood_map_base::erase_slot(size_type idx) {
+  // Backward shift: move the following elements that are not at their home one slot closer
+  // to it, so no tombstone is left behind.
+  auto last = idx;
+  for (; last + 1 < m_total && distance(m_tags[last + 1]) > 1; ++last) m_tags[last] = m_tags[last + 1] - 1;
+  if (m_alloc->trivially_relocatable()) {
+    std::memmove(slot(idx), slot(idx + 1), (last - idx) * m_elem_size);
+    FSTL_INSTRUMENT_ADD(robin_hood_map, moves, last - idx);
+  } else {
+    for (; idx != last; ++idx) relocate(slot(idx), slot(idx + 1));
+  }
+  m_tags[last] = 0;
+  --m_size;
+}
+
+size_type robin_hood_map_base::capacity_for(size_type count) const {
+  size_type capacity = MIN_CAPACITY;
+  while (capacity * m_max_load_factor < count) capacity *= 2;
+  return capacity;
+}
+
+void robin_hood_map_base::reserve_one(bool keep_staged) {
+  if (m_capacity != 0 && m_size + 1 <= m_capacity * m_max_load_factor) return;
+  resize(capacity_for(m_size + 1), keep_staged);
+}
+
+void robin_hood_map_base::throw_too_many_equal_hashes() {
+  throw std::length_error("unordered_map: too many keys with equal hashes");
+}
+
+bool robin_hood_map_base::plan_layout(size_type capacity, unsigned short *tags, size_type *source) const {
+  auto total = capacity + probe_limit(capacity);
+  std::memset(tags, 0, total * sizeof(*tags));
+  for (size_type j = 0; j < m_total; ++j) {
+    if (m_tags[j] == 0) continue;
+    auto hash = hash_of(slot(j));
+    size_type pos, last;
+    unsigned dist;
+    if (!find_place(tags, capacity, total, hash, pos, last, dist)) return false;
+    for (; last != pos; --last) {
+      tags[last] = tags[last - 1] + 1;
+      source[last] = source[last - 1];
+    }
+    tags[pos] = fingerprint(hash) | dist;
+    source[pos] = j;
+  }
+  return true;
+}
+
+void robin_hood_map_base::resize(size_type capacity, bool keep_staged) {
+  // Lay the new table out before moving anything, doubling it while some element would pass
+  // the probe limit: if that throws, this table is left as it was.
+  fstl::vector<unsigned short> tags;
+  fstl::vector<size_type> source;
+  for (;; capacity *= 2) {
+    tags.resize(capacity + probe_limit(capacity));
+    source.resize(tags.size());
+    if (plan_layout(capacity, tags.data(), source.data())) break;
+    // Growing cannot separate keys whose hashes are equal; only a mostly empty table that
+    // still overflows has that many of them.
+    if (m_size < capacity / 8) throw_too_many_equal_hashes();
+  }
+
+  auto *old_slots = m_slots;
+  auto old_total = m_total;
+  allocate_table(capacity);
+  if (old_slots) FSTL_INSTRUMENT_ADD(robin_hood_map, rehashes, 1);
+  if (old_slots) FSTL_INSTRUMENT_ADD(robin_hood_map, reallocations, 1);
+  std::memcpy(m_tags, tags.data(), m_total * sizeof(*m_tags));
+  if (keep_staged) relocate(slot(m_total), old_slots + old_total * m_elem_size);
+  for (size_type j = 0; j < m_total; ++j) {
+    if (m_tags[j] != 0) relocate(slot(j), old_slots + source[j] * m_elem_size);
+  }
+  if (old_slots) m_alloc->deallocate(old_slots, allocation_units(old_total, m_elem_size));
+}
+
+void robin_hood_map_base::max_load_factor(float ml) {
+  m_max_load_factor = ml < 0.5f ? 0.5f : ml > 0.95f ? 0.95f : ml;
+  if (m_capacity != 0 && m_size > m_capacity * m_max_load_factor) resize(capacity_for(m_size));
+}
+
+void robin_hood_map_base::rehash(size_type count) {
+  size_type capacity = MIN_CAPACITY;
+  while (capacity < count) capacity *= 2;
+  auto min_capacity = capacity_for(m_size);
+  if (capacity < min_capacity) capacity = min_capacity;
+  if (capacity != m_capacity) resize(capacity);
+}
+
+void robin_hood_map_base::reserve(size_type count) {
+  auto capacity = capacity_for(count);
+  if (capacity > m_capacity) resize(capacity);
+}
+
+size_type robin_hood_map_base::max_probe_length() const {
+  unsigned longest = 0;
+  for (size_type j = 0; j < m_total; ++j) {
+    if (distance(m_tags[j]) > longest) longest = distance(m_tags[j]);
+  }
+  return longest;
+}
+
+fstl::pair<robin_hood_map_base::iterator, bool> robin_hood_map_base::insert_copy(const void *key, const void *pair) {
+  auto hash = hash_of(key);
+  auto idx = find_index(key, hash);
+  if (idx != m_total) {
+    return {{this, idx}, false};
+  }
+  // Built in the staging slot, since placing it may move other elements first.
+  reserve_one();
+  void *staged = slot(m_total);
+  m_alloc->construct_copy(staged, pair);
+  try {
+    idx = place(hash, staged);
+  } catch (...) {
+    m_alloc->destruct(slot(m_total));
+    throw;
+  }
+  return {{this, idx}, true};
+}
+
+robin_hood_map_base::emplace_handle robin_hood_map_base::prepare_emplace() {
+  // Only an empty table grows before the pair is built: the arguments may refer to elements,
+  // which must not move until then. commit_emplace makes room for the others.
+  if (m_capacity == 0) reserve_one();
+  return slot(m_total);
+}
+
+fstl::pair<robin_hood_map_base::iterator, bool> robin_hood_map_base::commit_emplace(emplace_handle staged) {
+  // The key is the first member of the stored pair.
+  auto hash = hash_of(staged);
+  auto idx = find_index(staged, hash);
+  if (idx != m_total) {
+    m_alloc->destruct(staged);
+    return {{this, idx}, false};
+  }
+  try {
+    // A resize carries the staged pair over to the staging slot of the new table.
+    reserve_one(true);
+    idx = place(hash, slot(m_total));
+  } catch (...) {
+    m_alloc->destruct(slot(m_total));
+    throw;
+  }
+  return {{this, idx}, true};
+}
+
+void robin_hood_map_base::find_batch(const void *keys, size_t stride, size_type count, void **out) const {
+  auto *key_bytes = static_cast<const char *>(keys);
+  size_type hashes[batch_size];
+  for (size_type first = 0; first < count; first += batch_size) {
+    auto n = count - first < batch_size ? count - first : batch_size;
+    const char *batch = key_bytes + first * stride;
+    if (m_size == 0) {
+      for (size_type j = 0; j < n; ++j) out[first + j] = nullptr;
+      continue;
+    }
+    // Hash the whole batch, prefetching the home tag and slot of each key...
+    for (size_type j = 0; j < n; ++j) {
+      hashes[j] = hash_of(batch + j * stride);
+      auto home = hashes[j] & (m_capacity - 1);
+      prefetch(m_tags + home);
+      prefetch(slot(home));
+    }
+    // ...and only then compare keys.
+    for (size_type j = 0; j < n; ++j) {
+      auto idx = find_index(batch + j * stride, hashes[j]);
+      out[first + j] = idx != m_total ? slot(idx) : nullptr;
+    }
+  }
+}
+
+void robin_hood_map_base::contains_batch(const void *keys, size_t stride, size_type count, bool *out) const {
+  void *found[batch_size];
+  auto *key_bytes = static_cast<const char *>(keys);
+  for (size_type first = 0; first < count; first += batch_size) {
+    auto n = count - first < batch_size ? count - first : batch_size;
+    find_batch(key_bytes + first * stride, stride, n, found);
+    for (size_type j = 0; j < n; ++j) out[first + j] = found[j] != nullptr;
+  }
+}
+
+size_type robin_hood_map_base::erase(const void *key) {
+  auto idx = find_index(key, hash_of(key));
+  if (idx == m_total) return 0;
+  erase({this, idx});
+  return 1;
+}
+
+robin_hood_map_base::iterator robin_hood_map_base::erase(iterator pos) {
+  m_alloc->destruct(slot(pos.m_index));
+  erase_slot(pos.m_index);
+  // Probes never wrap around, so the element shifted into `pos`, if any, is one that
+  // iteration has not reached yet.
+  return {this, next_full(pos.m_index)};
+}
+
+void robin_hood_map_base::merge(robin_hood_map_base &other) {
+  if (&other == this) return;
+  for (size_type j = 0; j < other.m_total;) {
+    void *src = other.slot(j);
+    if (other.m_tags[j] == 0 || find_index(src, hash_of(src)) != m_total) {
+      ++j;
+      continue;
+    }
+    reserve_one();
+    place(hash_of(src), src);
+    // Shifts the following elements of `other` back, possibly into slot j.
+    other.erase_slot(j);
+  }
+}
+
+void robin_hood_map_base::throw_out_of_range() {
+  throw std::out_of_range("unordered_map does not contain key");
+}
+
+void *robin_hood_map_base::at(const void *key) {
+  auto idx = find_index(key, hash_of(key));
+  if (idx != m_total) {
+    return slot(idx);
+  }
+  throw_out_of_range();
+}
+
+void *robin_hood_map_base::operator[](const void *key) {
+  auto hash = hash_of(key);
+  auto idx = find_index(key, hash);
+  if (idx != m_total) {
+    return slot(idx);
+  }
+  reserve_one();
+  void *staged = slot(m_total);
+  m_alloc->construct_pair_copy_default(staged, key);
+  try {
+    idx = place(hash, staged);
+  } catch (...) {
+    m_alloc->destruct(slot(m_total));
+    throw;
+  }
+  return slot(idx);
+}
+
+size_type robin_hood_map_base::count(const void *key) const {
+  return find_index(key, hash_of(key)) != m_total ? 1 : 0;
+}
+
+robin_hood_map_base::iterator robin_hood_map_base::find(const void *key) const {
+  return {this, find_index(key, hash_of(key))};
+}
+
+robin_hood_map_base::iterator robin_hood_map_base::find(const void *key, size_type hash, erased_key_eq_fn eq) const {
+  return {this, probe(mix(hash), [&](const void *stored) { return eq(m_equal, key, stored); })};
+}
+
+size_type robin_hood_map_base::next_full(size_type idx) const {
+  // Skip runs of empty slots four tags at a time.
+  while (idx + 4 <= m_total) {
+    uint64_t tags;
+    std::memcpy(&tags, m_tags + idx, sizeof(tags));
+    if (tags != 0) break;
+    idx += 4;
+  }
+  while (idx < m_total && m_tags[idx] == 0) ++idx;
+  return idx;
+}
+
+robin_hood_map_base::iterator robin_hood_map_base::begin() const { return {this, next_full(0)}; }
+
+size_type robin_hood_map_base::bucket_size(size_type idx) const {
+  return idx < m_total && m_tags[idx] != 0 ? 1 : 0;
+}
+
+hash_table_stats robin_hood_map_base::stats() const {
+  hash_table_stats result;
+  result.size = m_size;
+  result.bucket_count = m_capacity;
+  result.load_factor = load_factor();
+  if (m_total == 0) return result;
+  result.memory_bytes = allocation_units(m_total, m_elem_size) * m_elem_size;
+
+  // The elements are ordered by home slot, so those of one home slot are adjacent.
+  double sum_of_squares = 0;
+  size_type home = m_total, run = 0;
+  for (size_type j = 0; j < m_total; ++j) {
+    if (m_tags[j] == 0) {
+      if (j < m_capacity) ++result.empty_buckets;
+      continue;
+    }
+    size_type length = distance(m_tags[j]);
+    ++result.length_histogram[length < hash_table_stats::histogram_size ? length : hash_table_stats::histogram_size - 1];
+    if (length > result.max_length) result.max_length = length;
+    if (j + 1 - length != home) {
+      sum_of_squares += double(run) * run;
+      home = j + 1 - length;
+      run = 0;
+    }
+    ++run;
+  }
+  sum_of_squares += double(run) * run;
+  set_uniformity(result, m_capacity, sum_of_squares);
+  return result;
+}
+
+void robin_hood_map_base::clear() {
+  if (m_total == 0) return;
+  if (!m_alloc->trivially_copyable()) {
+    for (size_type j = 0; j < m_total; ++j) {
+      if (m_tags[j] != 0) m_alloc->destruct(slot(j));
+    }
+  }
+  std::memset(m_tags, 0, m_total * sizeof(*m_tags));
+  m_size = 0;
+}
+
+void *robin_hood_iterator_base::data() const { return m_map->slot(m_index); }
+
+robin_hood_iterator_base &robin_hood_iterator_base::next() {
+  m_index = m_map->next_full(m_index + 1);
+  return *this;
+}
+}
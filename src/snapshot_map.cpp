@@ -0,0 +1,162 @@
+#include "fstl/snapshot_map.h"
+#include "fstl/detail/instrument.h"
+
+#include <cstring>
+#include <stdexcept>
+#include <thread>
+
+namespace fstl::detail {
+// Followed in the same allocation by offsets[bucket_mask + 2] (the elements of bucket b are
+// [offsets[b], offsets[b + 1])), hashes[size] and, at elements_offset, the elements.
+struct snapshot_table {
+  using size_type = snapshot_map_base::size_type;
+
+  size_type size;
+  size_type bucket_mask;
+  size_type elements_offset;
+  size_type bytes;
+
+  unsigned *offsets() { return reinterpret_cast<unsigned *>(this + 1); }
+  size_type *hashes() { return reinterpret_cast<size_type *>(offsets() + round_up(bucket_mask + 2, 2)); }
+  char *elements() { return reinterpret_cast<char *>(this) + elements_offset; }
+
+  static size_type round_up(size_type n, size_type multiple) { return (n + multiple - 1) / multiple * multiple; }
+};
+
+snapshot_map_base::snapshot_map_base(const void *const *items, size_type count, void (copy)(void *, const void *),
+                                     erased_hash_base *hash, erased_compare_base *key_eq, erased_allocator_base *alloc)
+  : m_table(nullptr)
+  , m_hash(instrumented(hash, instrument::container::snapshot_map))
+  , m_equal(key_eq)
+  , m_alloc(instrumented(alloc, instrument::container::snapshot_map))
+{
+  if (count >= (size_type(1) << 32)) throw std::length_error("snapshot_map too large");
+
+  // One bucket per element, rounded to a power of two: about one key compare per lookup.
+  size_type buckets = 1;
+  while (buckets < count) buckets *= 2;
+  size_type mask = buckets - 1;
+
+  // Counting sort of the items by bucket, keeping their order within a bucket.
+  fstl::vector<size_type> item_hashes;
+  fstl::vector<unsigned> starts;
+  fstl::vector<unsigned> order;
+  item_hashes.reserve(count);
+  starts.resize(buckets + 1);
+  order.resize(count);
+  for (size_type j = 0; j < count; ++j) {
+    item_hashes.push_back(m_hash->hash(items[j]));
+    ++starts[(item_hashes[j] & mask) + 1];
+  }
+  for (size_type b = 0; b < buckets; ++b) starts[b + 1] += starts[b];
+  {
+    fstl::vector<unsigned> fill(starts);
+    for (size_type j = 0; j < count; ++j) order[fill[item_hashes[j] & mask]++] = static_cast<unsigned>(j);
+  }
+
+  // Drop later duplicates, compacting each bucket's run of `order` in place.
+  size_type kept = 0;
+  fstl::vector<unsigned> offsets;
+  offsets.resize(buckets + 1);
+  for (size_type b = 0; b < buckets; ++b) {
+    offsets[b] = static_cast<unsigned>(kept);
+    for (size_type j = starts[b]; j < starts[b + 1]; ++j) {
+      auto item = order[j];
+      bool duplicate = false;
+      for (size_type k = offsets[b]; k < kept && !duplicate; ++k) {
+        duplicate = item_hashes[order[k]] == item_hashes[item] && m_equal->compare_eq(items[order[k]], items[item]);
+      }
+      if (!duplicate) order[kept++] = item;
+    }
+  }
+  offsets[buckets] = static_cast<unsigned>(kept);
+
+  auto elem_size = m_alloc->element_size();
+  auto header = sizeof(snapshot_table) + snapshot_table::round_up(buckets + 1, 2) * sizeof(unsigned)
+                + kept * sizeof(size_type);
+  auto elements_offset = snapshot_table::round_up(header, ll_node_header_size);
+  auto bytes = elements_offset + kept * elem_size;
+
+  auto *table = static_cast<snapshot_table *>(m_alloc->allocate_node(bytes));
+  table->size = 0;
+  table->bucket_mask = mask;
+  table->elements_offset = elements_offset;
+  table->bytes = bytes;
+  std::memcpy(table->offsets(), offsets.data(), (buckets + 1) * sizeof(unsigned));
+  try {
+    for (size_type j = 0; j < kept; ++j) {
+      table->hashes()[j] = item_hashes[order[j]];
+      copy(table->elements() + j * elem_size, items[order[j]]);
+      ++table->size;
+    }
+  } catch (...) {
+    destroy(table);
+    throw;
+  }
+  m_table = table;
+}
+
+void snapshot_map_base::destroy(snapshot_table *table) const {
+  auto elem_size = m_alloc->element_size();
+  for (size_type j = 0; j < table->size; ++j) m_alloc->destruct(table->elements() + j * elem_size);
+  m_alloc->deallocate_node(table, table->bytes);
+}
+
+snapshot_map_base::~snapshot_map_base() {
+  destroy(m_table);
+  release_adapter(m_alloc);
+  release_adapter(m_hash);
+  release_adapter(m_equal);
+}
+
+snapshot_map_base::size_type snapshot_map_base::size() const { return m_table->size; }
+
+snapshot_map_base::size_type snapshot_map_base::bucket_count() const { return m_table->bucket_mask + 1; }
+
+const void *snapshot_map_base::find(const void *key) const {
+  auto hash = m_hash->hash(key);
+  auto bucket = hash & m_table->bucket_mask;
+  auto *offsets = m_table->offsets();
+  auto *hashes = m_table->hashes();
+  auto elem_size = m_alloc->element_size();
+  for (size_type j = offsets[bucket]; j < offsets[bucket + 1]; ++j) {
+    auto *elem = m_table->elements() + j * elem_size;
+    if (hashes[j] == hash && m_equal->compare_eq(key, elem)) {
+      FSTL_INSTRUMENT_PROBE(snapshot_map, j - offsets[bucket] + 1);
+      return elem;
+    }
+  }
+  FSTL_INSTRUMENT_PROBE(snapshot_map, offsets[bucket + 1] - offsets[bucket]);
+  return nullptr;
+}
+
+const void *snapshot_map_base::data() const { return m_table->elements(); }
+
+void snapshot_map_base::throw_out_of_range() {
+  throw std::out_of_range("snapshot_map::at");
+}
+
+unsigned rcu_cell_base::next_reader_slot() {
+  static unsigned threads = 0;
+  return __atomic_fetch_add(&threads, 1, __ATOMIC_RELAXED) % reader_slots;
+}
+
+void rcu_cell_base::publish(void *next) {
+  // Publishers are rare and brief, so they spin on a flag rather than own a mutex.
+  while (__atomic_test_and_set(&m_publishing, __ATOMIC_ACQUIRE)) std::this_thread::yield();
+  auto *previous = __atomic_exchange_n(&m_current, next, __ATOMIC_SEQ_CST);
+  // A reader that saw `previous` had registered before the exchange, under either parity.
+  // Flip the parity and wait out the old one, twice: new readers register under the other
+  // counters, so each wait only covers readers already in progress. A reader unlocks the slot
+  // it locked, so every slot drains on its own.
+  for (int phase = 0; phase < 2; ++phase) {
+    auto old_parity = m_parity;
+    __atomic_store_n(&m_parity, old_parity ^ 1, __ATOMIC_SEQ_CST);
+    for (auto &slot : m_readers[old_parity]) {
+      while (__atomic_load_n(&slot.count, __ATOMIC_ACQUIRE) != 0) std::this_thread::yield();
+    }
+  }
+  __atomic_clear(&m_publishing, __ATOMIC_RELEASE);
+  if (previous) m_destroy(previous);
+}
+}
@@ -1,9 +1,12 @@
 #include "fstl/unordered_map.h"
 #include "fstl/forward_list.h"
 
+#include "fstl/detail/instrument.h"
+#include "fstl/detail/prefetch.h"
 #include "fstl/utility.h"
 
 #include <cstdlib>
+#include <cstring>
 #include <new>
 #include <stdexcept>
 #include <fstl/unordered_map.h>
@@ -14,93 +17,464 @@ struct friendly_forward_list_base : fstl::detail::forward_list_base
 {
   friend class fstl::detail::unordered_map_base;
   friend struct fstl::detail::unordered_map_iterator_base;
+  friend struct fstl::detail::node_handle_base;
 };
 using fstl::detail::friendly_forward_list_base;
 
 
+// Smallest prime above each power of two, so prime bucket counts grow geometrically too.
+static constexpr unordered_map_base::size_type primes[] = {
+  2ul, 3ul, 5ul, 11ul, 17ul, 37ul, 67ul, 131ul, 257ul, 521ul, 1031ul, 2053ul, 4099ul, 8209ul, 16411ul,
+  32771ul, 65537ul, 131101ul, 262147ul, 524309ul, 1048583ul, 2097169ul, 4194319ul, 8388617ul,
+  16777259ul, 33554467ul, 67108879ul, 134217757ul, 268435459ul, 536870923ul, 1073741827ul,
+  2147483659ul, 4294967311ul, 8589934609ul, 17179869209ul, 34359738421ul, 68719476767ul,
+  137438953481ul, 274877906951ul, 549755813911ul, 1099511627791ul, 2199023255579ul,
+  4398046511119ul, 8796093022237ul, 17592186044423ul, 35184372088891ul, 70368744177679ul,
+  140737488355333ul, 281474976710677ul, 562949953421381ul, 1125899906842679ul,
+  2251799813685269ul, 4503599627370517ul, 9007199254740997ul, 18014398509482143ul,
+  36028797018963971ul, 72057594037928017ul, 144115188075855881ul, 288230376151711813ul,
+  576460752303423619ul, 1152921504606847009ul, 2305843009213693967ul, 4611686018427388039ul,
+  9223372036854775837ul,
+};
+
+static unordered_map_base::size_type bitmap_words(unordered_map_base::size_type buckets) { return (buckets + 63) / 64; }
+
+static int lowest_bit(unsigned long long word)
+{
+#ifdef _MSC_VER
+  unsigned long idx;
+  _BitScanForward64(&idx, word);
+  return static_cast<int>(idx);
+#else
+  return __builtin_ctzll(word);
+#endif
+}
+
+// Fewest buckets that keep `count` elements within the maximum load factor.
+static unordered_map_base::size_type buckets_for(unordered_map_base::size_type count, float max_load_factor)
+{
+  float exact = count / max_load_factor;
+  auto buckets = static_cast<unordered_map_base::size_type>(exact);
+  return buckets < exact ? buckets + 1 : buckets;
+}
+
 unordered_map_base::unordered_map_base(unordered_map_base::size_type num_buckets, detail::erased_hash_base *hash,
                                        detail::erased_compare_base *key_eq, detail::erased_allocator_base *alloc)
-  : m_table(new friendly_forward_list_base[num_buckets])
-  , m_hash(hash)
+  : m_table(nullptr)
+  , m_occupied(nullptr)
+  , m_hash(instrumented(hash, instrument::container::unordered_map))
   , m_equal(key_eq)
-  , m_alloc(alloc)
+  , m_alloc(instrumented(alloc, instrument::container::unordered_map))
   , m_size(0)
-  , m_num_buckets(num_buckets)
+  , m_num_buckets(0)
 {
-  for (int j = 0; j < num_buckets; ++j) {
-    m_table[j].set_allocator(m_alloc);
+  rehash(num_buckets);
+}
+
+unordered_map_base::unordered_map_base(const unordered_map_base &other)
+  : m_table(new friendly_forward_list_base[other.m_num_buckets])
+  , m_occupied(new unsigned long long[bitmap_words(other.m_num_buckets)])
+  , m_alloc(other.m_alloc->clone())
+  , m_hash(other.m_hash->clone())
+  , m_equal(other.m_equal->clone())
+  , m_size(other.m_size)
+  , m_num_buckets(other.m_num_buckets)
+  , m_max_load_factor(other.m_max_load_factor)
+  , m_policy(other.m_policy)
+{
+  std::memcpy(m_occupied, other.m_occupied, bitmap_words(m_num_buckets) * sizeof(*m_occupied));
+  for (size_type j = 0; j < m_num_buckets; ++j) {
+    auto &bucket = m_table[j];
+    bucket.set_allocator(m_alloc);
+    auto &other_bucket = other.m_table[j];
+    for (auto it = other_bucket.begin(); it != other_bucket.end(); ++it) {
+      auto *node = bucket.new_node();
+      m_alloc->construct_copy(emplace_data(node), *it);
+      friendly_forward_list_base::set_node_hash(node, friendly_forward_list_base::node_hash(it.m_node));
+      bucket.link_front(node);
+    }
   }
 }
 
-fstl::pair<unordered_map_base::iterator, bool> unordered_map_base::insert_copy(const void *key, const void *pair) {
-  auto bucket_idx = m_hash->hash(key) % m_num_buckets;
-  auto &bucket = m_table[m_hash->hash(key) % m_num_buckets];
-  // Check if container contains the key already.
-  auto foundit = bucket.find(key, m_equal);
-  if (*foundit != nullptr) {
-    return {{this, foundit.m_node, bucket_idx}, false};
+unordered_map_base::unordered_map_base(unordered_map_base &&other) noexcept
+  : m_table(other.m_table)
+  , m_occupied(other.m_occupied)
+  , m_alloc(other.m_alloc)
+  , m_hash(other.m_hash)
+  , m_equal(other.m_equal)
+  , m_size(other.m_size)
+  , m_num_buckets(other.m_num_buckets)
+  , m_max_load_factor(other.m_max_load_factor)
+  , m_policy(other.m_policy)
+{
+  // The source stays usable: empty, with adapters of its own (free if stateless).
+  other.m_table = nullptr;
+  other.m_occupied = nullptr;
+  other.m_alloc = m_alloc->clone();
+  other.m_hash = m_hash->clone();
+  other.m_equal = m_equal->clone();
+  other.m_size = 0;
+  other.m_num_buckets = 0;
+  other.rehash(0);
+}
+
+unordered_map_base &unordered_map_base::operator=(const unordered_map_base &other) {
+  if (this != &other) {
+    this->~unordered_map_base();
+    new (this) unordered_map_base(other);
+  }
+  return *this;
+}
+
+unordered_map_base &unordered_map_base::operator=(unordered_map_base &&other) noexcept {
+  this->~unordered_map_base();
+  new (this) unordered_map_base(static_cast<unordered_map_base &&>(other));
+  return *this;
+}
+
+unordered_map_base::~unordered_map_base() {
+  clear();
+  delete[] m_table;
+  delete[] m_occupied;
+  release_adapter(m_alloc);
+  release_adapter(m_hash);
+  release_adapter(m_equal);
+}
+
+unordered_map_base::size_type unordered_map_base::round_bucket_count(size_type count) const {
+  if (m_policy == fstl::bucket_policy::power_of_two) {
+    size_type buckets = 1;
+    while (buckets < count) buckets *= 2;
+    return buckets;
+  }
+  for (auto prime : primes) {
+    if (prime >= count) return prime;
+  }
+  throw std::length_error("unordered_map bucket count too large");
+}
+
+void unordered_map_base::rehash(size_type count) {
+  auto min_buckets = buckets_for(m_size, m_max_load_factor);
+  count = round_bucket_count(count < min_buckets ? min_buckets : count);
+  if (count == m_num_buckets) return;
+  if (m_table) FSTL_INSTRUMENT_ADD(unordered_map, rehashes, 1);
+
+  auto *old_table = m_table;
+  auto old_num_buckets = m_num_buckets;
+  auto *occupied = new unsigned long long[bitmap_words(count)]();
+  m_table = new friendly_forward_list_base[count];
+  delete[] m_occupied;
+  m_occupied = occupied;
+  m_num_buckets = count;
+  for (size_type j = 0; j < count; ++j) {
+    m_table[j].set_allocator(m_alloc);
   }
-  bucket.push_front_copy(pair);
+  // Move the nodes themselves: no element is copied, no node is reallocated and the hash
+  // stored in each node saves calling the hash function again.
+  for (size_type j = 0; j < old_num_buckets; ++j) {
+    auto &bucket = old_table[j];
+    while (!bucket.empty()) {
+      auto *node = bucket.unlink_front();
+      auto bucket_idx = bucket_index(friendly_forward_list_base::node_hash(node));
+      m_table[bucket_idx].link_front(node);
+      mark_occupied(bucket_idx);
+    }
+  }
+  delete[] old_table;
+}
+
+void unordered_map_base::reserve(size_type count) {
+  rehash(buckets_for(count, m_max_load_factor));
+}
+
+void unordered_map_base::max_load_factor(float ml) {
+  m_max_load_factor = ml;
+  if (m_size > m_num_buckets * ml) rehash(0);
+}
+
+void unordered_map_base::bucket_policy(fstl::bucket_policy policy) {
+  if (policy == m_policy) return;
+  m_policy = policy;
+  rehash(m_num_buckets);
+}
+
+ll_node *unordered_map_base::new_node() {
+  // All buckets share m_alloc, so any of them can hand out nodes.
+  return m_table[0].new_node();
+}
+
+unordered_map_base::iterator unordered_map_base::link_node(ll_node *node, size_type hash) {
+  grow_for(m_size + 1);
+  auto bucket_idx = bucket_index(hash);
+  friendly_forward_list_base::set_node_hash(node, hash);
+  m_table[bucket_idx].link_front(node);
+  mark_occupied(bucket_idx);
   ++m_size;
-  return {{this, bucket.first_node(), bucket_idx}, true};
+  return {this, node, bucket_idx};
 }
 
-void *unordered_map_base::at(const void *key) {
-  auto bucket_idx = m_hash->hash(key) % m_num_buckets;
+void unordered_map_base::drop_node(ll_node *node) { m_table[0].drop_node(node); }
+
+void unordered_map_base::grow_for(size_type count) {
+  if (count <= m_num_buckets * m_max_load_factor) return;
+  // Both policies round up to about twice the current count.
+  auto needed = buckets_for(count, m_max_load_factor);
+  rehash(needed > m_num_buckets + 1 ? needed : m_num_buckets + 1);
+}
+
+unordered_map_base::iterator unordered_map_base::find(const void *key, size_type hash) const {
+  if (m_size == 0) return end();
+  auto bucket_idx = bucket_index(hash);
   auto &bucket = m_table[bucket_idx];
-  auto data_it = bucket.find(key, m_equal);
+  auto data_it = bucket.find(key, hash, m_equal);
   if (data_it != bucket.end()) {
-    return *data_it;
+    return {this, data_it.m_node, bucket_idx};
   }
-  throw std::out_of_range("unordered_map does not contain key");
+  return end();
 }
 
-void *unordered_map_base::operator[](const void *key) {
-  auto bucket_idx = m_hash->hash(key) % m_num_buckets;
+unordered_map_base::iterator unordered_map_base::find(const void *key, size_type hash, erased_key_eq_fn eq) const {
+  if (m_size == 0) return end();
+  auto bucket_idx = bucket_index(hash);
   auto &bucket = m_table[bucket_idx];
-  auto data_it = bucket.find(key, m_equal);
+  auto data_it = bucket.find(key, hash, eq, m_equal);
   if (data_it != bucket.end()) {
-    return *data_it;
+    return {this, data_it.m_node, bucket_idx};
   }
-  // Default construct a value.
-  // FIXME: This is very inefficient!
-  auto *storage = m_alloc->allocate(1);
-  m_alloc->construct_pair_copy_default(storage, key);
-  bucket.push_front_copy(storage);
-  ++m_size;
-  m_alloc->destruct(storage);
+  return end();
+}
 
-  return bucket.front();
+fstl::pair<unordered_map_base::iterator, bool> unordered_map_base::insert_copy(const void *key, const void *pair) {
+  auto hash = m_hash->hash(key);
+  // Check if container contains the key already.
+  auto foundit = find(key, hash);
+  if (foundit != end()) {
+    return {foundit, false};
+  }
+  auto *node = new_node();
+  m_alloc->construct_copy(emplace_data(node), pair);
+  return {link_node(node, hash), true};
 }
 
-unordered_map_base::iterator unordered_map_base::begin() const
+unordered_map_base::emplace_handle unordered_map_base::prepare_emplace() { return new_node(); }
+
+void *unordered_map_base::emplace_data(emplace_handle node) { return friendly_forward_list_base::node_data(node); }
+
+fstl::pair<unordered_map_base::iterator, bool> unordered_map_base::commit_emplace(emplace_handle node) {
+  // The key is the first member of the stored pair.
+  const void *key = emplace_data(node);
+  auto hash = m_hash->hash(key);
+  auto foundit = find(key, hash);
+  if (foundit != end()) {
+    m_alloc->destruct(emplace_data(node));
+    drop_node(node);
+    return {foundit, false};
+  }
+  return {link_node(node, hash), true};
+}
+
+void unordered_map_base::find_batch(const void *keys, size_t stride, size_type count, void **out) const {
+  auto *key_bytes = static_cast<const char *>(keys);
+  size_type hashes[batch_size];
+  for (size_type first = 0; first < count; first += batch_size) {
+    auto n = count - first < batch_size ? count - first : batch_size;
+    const char *batch = key_bytes + first * stride;
+    if (m_size == 0) {
+      for (size_type j = 0; j < n; ++j) out[first + j] = nullptr;
+      continue;
+    }
+    // Hash the whole batch, prefetching the bucket heads...
+    for (size_type j = 0; j < n; ++j) {
+      hashes[j] = m_hash->hash(batch + j * stride);
+      prefetch(&m_table[bucket_index(hashes[j])]);
+    }
+    // ...then the first node of each bucket...
+    for (size_type j = 0; j < n; ++j) {
+      prefetch(m_table[bucket_index(hashes[j])].first_node());
+    }
+    // ...and only then walk the buckets.
+    for (size_type j = 0; j < n; ++j) {
+      auto foundit = find(batch + j * stride, hashes[j]);
+      out[first + j] = foundit != end() ? foundit.data() : nullptr;
+    }
+  }
+}
+
+void unordered_map_base::contains_batch(const void *keys, size_t stride, size_type count, bool *out) const {
+  void *found[batch_size];
+  auto *key_bytes = static_cast<const char *>(keys);
+  for (size_type first = 0; first < count; first += batch_size) {
+    auto n = count - first < batch_size ? count - first : batch_size;
+    find_batch(key_bytes + first * stride, stride, n, found);
+    for (size_type j = 0; j < n; ++j) out[first + j] = found[j] != nullptr;
+  }
+}
+
+unordered_map_base::size_type unordered_map_base::erase(const void *key) {
+  auto foundit = find(key);
+  if (foundit == end()) return 0;
+  erase(foundit);
+  return 1;
+}
+
+unordered_map_base::iterator unordered_map_base::erase(iterator pos) {
+  auto next = pos;
+  next.next();
+  auto &bucket = m_table[pos.m_current_bucket];
+  bucket.unlink(pos.m_bucket_it);
+  if (bucket.empty()) mark_empty(pos.m_current_bucket);
+  m_alloc->destruct(emplace_data(pos.m_bucket_it));
+  bucket.drop_node(pos.m_bucket_it);
+  --m_size;
+  return next;
+}
+
+node_handle_base unordered_map_base::extract(iterator pos) {
+  auto &bucket = m_table[pos.m_current_bucket];
+  bucket.unlink(pos.m_bucket_it);
+  if (bucket.empty()) mark_empty(pos.m_current_bucket);
+  --m_size;
+  return {pos.m_bucket_it, retain_adapter(m_alloc)};
+}
+
+fstl::pair<unordered_map_base::iterator, bool> unordered_map_base::insert_node(node_handle_base &handle) {
+  if (handle.empty()) return {end(), false};
+  const void *key = handle.data();
+  auto hash = m_hash->hash(key);
+  auto foundit = find(key, hash);
+  if (foundit != end()) {
+    return {foundit, false};
+  }
+  ll_node *node;
+  if (handle.m_alloc == m_alloc) {
+    node = handle.release();
+  } else {
+    // Only the allocator that made a node may free it.
+    node = new_node();
+    m_alloc->construct_move(emplace_data(node), handle.data());
+    handle.reset();
+  }
+  return {link_node(node, hash), true};
+}
+
+void unordered_map_base::merge(unordered_map_base &other) {
+  if (&other == this) return;
+  // The same hash adapter gives the same hashes, so the stored ones can be kept.
+  bool same_hash = m_hash == other.m_hash;
+  for (size_type j = other.next_occupied(0); j < other.m_num_buckets; j = other.next_occupied(j + 1)) {
+    auto &bucket = other.m_table[j];
+    for (auto it = bucket.begin(); it != bucket.end();) {
+      auto *node = it.m_node;
+      ++it;
+      const void *key = emplace_data(node);
+      auto hash = same_hash ? friendly_forward_list_base::node_hash(node) : m_hash->hash(key);
+      if (find(key, hash) == end()) {
+        bucket.unlink(node);
+        if (bucket.empty()) other.mark_empty(j);
+        --other.m_size;
+        if (other.m_alloc != m_alloc) {
+          auto *moved = new_node();
+          m_alloc->construct_move(emplace_data(moved), emplace_data(node));
+          other.m_alloc->destruct(emplace_data(node));
+          bucket.drop_node(node);
+          node = moved;
+        }
+        link_node(node, hash);
+      }
+    }
+  }
+}
+
+node_handle_base::node_handle_base(node_handle_base &&other) noexcept
+  : m_node(other.m_node)
+  , m_alloc(other.m_alloc)
 {
-  for (size_type j = 0; j < m_num_buckets; ++j) {
-    auto &bucket = m_table[j];
-    if (bucket.empty()) continue;
-    return {this, bucket.first_node(), j};
+  other.m_node = nullptr;
+  other.m_alloc = nullptr;
+}
+
+node_handle_base &node_handle_base::operator=(node_handle_base &&other) noexcept {
+  if (this != &other) {
+    reset();
+    m_node = other.m_node;
+    m_alloc = other.m_alloc;
+    other.m_node = nullptr;
+    other.m_alloc = nullptr;
   }
-  return end();
+  return *this;
 }
 
-unordered_map_base::size_type unordered_map_base::count(const void *key) const {
-  auto bucket_idx = m_hash->hash(key) % m_num_buckets;
-  auto &bucket = m_table[bucket_idx];
-  auto data_it = bucket.find(key, m_equal);
-  if (data_it != bucket.end()) {
-    return 1;
+void *node_handle_base::data() const { return friendly_forward_list_base::node_data(m_node); }
+
+void node_handle_base::reset() {
+  if (m_node) {
+    m_alloc->destruct(data());
+    friendly_forward_list_base::drop_node(m_node, m_alloc);
+    m_node = nullptr;
   }
-  return 0;
+  release_adapter(m_alloc);
+  m_alloc = nullptr;
 }
 
-unordered_map_base::iterator unordered_map_base::find(const void *key) const {
-  auto bucket_idx = m_hash->hash(key) % m_num_buckets;
-  auto &bucket = m_table[bucket_idx];
-  auto data_it = bucket.find(key, m_equal);
-  if (data_it != bucket.end()) {
-    return {this, data_it.m_node, bucket_idx};
+ll_node *node_handle_base::release() {
+  auto *node = m_node;
+  m_node = nullptr;
+  release_adapter(m_alloc);
+  m_alloc = nullptr;
+  return node;
+}
+
+void unordered_map_base::throw_out_of_range() {
+  throw std::out_of_range("unordered_map does not contain key");
+}
+
+void *unordered_map_base::at(const void *key) {
+  auto foundit = find(key);
+  if (foundit != end()) {
+    return foundit.data();
+  }
+  throw_out_of_range();
+}
+
+void *unordered_map_base::operator[](const void *key) {
+  auto hash = m_hash->hash(key);
+  auto foundit = find(key, hash);
+  if (foundit != end()) {
+    return foundit.data();
   }
-  return {this, nullptr, m_num_buckets};
+  // Construct the (key, default value) pair in place in a new node.
+  auto *node = new_node();
+  m_alloc->construct_pair_copy_default(emplace_data(node), key);
+  link_node(node, hash);
+  return emplace_data(node);
+}
+
+unordered_map_base::size_type unordered_map_base::next_occupied(size_type bucket) const {
+  auto words = bitmap_words(m_num_buckets);
+  auto word = bucket / 64;
+  if (word >= words) return m_num_buckets;
+  // Drop the bits of the buckets before `bucket` in its word.
+  auto bits = m_occupied[word] & (~0ull << (bucket % 64));
+  while (bits == 0) {
+    if (++word == words) return m_num_buckets;
+    bits = m_occupied[word];
+  }
+  return word * 64 + lowest_bit(bits);
+}
+
+unordered_map_base::iterator unordered_map_base::begin() const
+{
+  auto j = next_occupied(0);
+  if (j == m_num_buckets) return end();
+  return {this, m_table[j].first_node(), j};
+}
+
+unordered_map_base::size_type unordered_map_base::count(const void *key) const {
+  return find(key) != end() ? 1 : 0;
+}
+
+unordered_map_base::iterator unordered_map_base::find(const void *key) const {
+  return find(key, m_hash->hash(key));
 }
 
 unordered_map_base::size_type unordered_map_base::bucket_size(unordered_map_base::size_type bucket_idx) const {
@@ -112,10 +486,32 @@ unordered_map_base::size_type unordered_map_base::bucket_size(unordered_map_base
   return num_elems;
 }
 
+hash_table_stats unordered_map_base::stats() const {
+  hash_table_stats result;
+  result.size = m_size;
+  result.bucket_count = m_num_buckets;
+  result.load_factor = load_factor();
+  result.empty_buckets = m_num_buckets;
+  result.memory_bytes = m_num_buckets * sizeof(*m_table) + bitmap_words(m_num_buckets) * sizeof(*m_occupied);
+  if (m_size) result.memory_bytes += m_size * (ll_node_header_size + m_alloc->element_size());
+  double sum_of_squares = 0;
+  for (size_type j = next_occupied(0); j < m_num_buckets; j = next_occupied(j + 1)) {
+    auto length = bucket_size(j);
+    --result.empty_buckets;
+    ++result.length_histogram[length < hash_table_stats::histogram_size ? length : hash_table_stats::histogram_size - 1];
+    if (length > result.max_length) result.max_length = length;
+    sum_of_squares += double(length) * length;
+  }
+  result.length_histogram[0] = result.empty_buckets;
+  set_uniformity(result, m_num_buckets, sum_of_squares);
+  return result;
+}
+
 void unordered_map_base::clear() {
-  for (size_type j = 0; j < m_num_buckets; ++j) {
+  for (size_type j = next_occupied(0); j < m_num_buckets; j = next_occupied(j + 1)) {
     m_table[j].clear();
   }
+  if (m_occupied) std::memset(m_occupied, 0, bitmap_words(m_num_buckets) * sizeof(*m_occupied));
   m_size = 0;
 }
 
@@ -127,12 +523,9 @@ unordered_map_iterator_base &unordered_map_iterator_base::next() {
   m_bucket_it = (++forward_list_iterator_base(m_bucket_it)).m_node;
 
   if (m_bucket_it == nullptr) {
-    // We are at the end of the current bucket. Go to the next if available.
-    detail::forward_list_base *fl = nullptr;
-    while (++m_current_bucket < m_umap->bucket_count()) {
-      auto &bucket = m_umap->m_table[m_current_bucket];
-      if (!bucket.empty()) { m_bucket_it = bucket.first_node(); return *this; }
-    }
+    // We are at the end of the current bucket: jump to the next one that is not empty.
+    m_current_bucket = m_umap->next_occupied(m_current_bucket + 1);
+    if (m_current_bucket < m_umap->m_num_buckets) m_bucket_it = m_umap->m_table[m_current_bucket].first_node();
   }
   return *this;
 }
@@ -1,41 +1,86 @@
 #include "fstl/vector.h"
+#include "fstl/detail/instrument.h"
 
+#include <cstring>
 #include <stdexcept>
 #include <fstl/vector.h>
 
 
 static constexpr float GROWTH_FACTOR = 1.4f;
 
+using fstl::erased_allocator_base;
+
+// Moves `count` elements from `src` into the uninitialized storage at `dst` and ends the
+// lifetime of the originals. The ranges may overlap as long as dst < src.
+static void relocate_forward(erased_allocator_base *alloc, fstl::size_t elem_size,
+                             char *dst, char *src, fstl::size_t count)
+{
+  if (count == 0 || dst == src) return;
+  if (alloc->trivially_relocatable()) {
+    std::memmove(dst, src, count * elem_size);
+    FSTL_INSTRUMENT_ADD(vector, moves, count);
+    return;
+  }
+  for (fstl::size_t j = 0; j < count; ++j) {
+    alloc->construct_move(dst, src);
+    alloc->destruct(src);
+    dst += elem_size;
+    src += elem_size;
+  }
+}
+
+// Same as relocate_forward, but walks the range back to front so that dst > src may overlap.
+static void relocate_backward(erased_allocator_base *alloc, fstl::size_t elem_size,
+                              char *dst, char *src, fstl::size_t count)
+{
+  if (count == 0 || dst == src) return;
+  if (alloc->trivially_relocatable()) {
+    std::memmove(dst, src, count * elem_size);
+    FSTL_INSTRUMENT_ADD(vector, moves, count);
+    return;
+  }
+  dst += count * elem_size;
+  src += count * elem_size;
+  for (fstl::size_t j = 0; j < count; ++j) {
+    dst -= elem_size;
+    src -= elem_size;
+    alloc->construct_move(dst, src);
+    alloc->destruct(src);
+  }
+}
+
 
 static void *ptr_at_idx(const fstl::vector_base &vec, fstl::size_t offset)
 {
-  return reinterpret_cast<char *>(vec.data()) + offset * vec.get_allocator()->element_size();
+  return reinterpret_cast<char *>(vec.data()) + offset * vec.element_size();
 }
 
 
 fstl::vector_base::vector_base(unsigned long count, erased_allocator_base *alloc)
-  : m_alloc(alloc)
+  : m_alloc(detail::instrumented(alloc, instrument::container::vector))
+  , m_elem_size(alloc->element_size())
   , m_capacity(count)
   , m_size(count)
 {
   m_data = m_alloc->allocate(count);
 
   for (size_type j = 0; j < count; ++j) {
-    void *p = reinterpret_cast<char *>(m_data) + j * m_alloc->element_size();
+    void *p = reinterpret_cast<char *>(m_data) + j * m_elem_size;
     m_alloc->construct(p);
   }
 }
 
 fstl::vector_base::vector_base(fstl::vector_base::size_type count, const void *val,
                                fstl::erased_allocator_base *alloc)
-  : m_alloc(alloc)
+  : m_alloc(detail::instrumented(alloc, instrument::container::vector))
+  , m_elem_size(alloc->element_size())
   , m_capacity(count)
   , m_size(count)
   {
   m_data = m_alloc->allocate(count);
 
   for (size_type j = 0; j < count; ++j) {
-    void *p = reinterpret_cast<char *>(m_data) + j * m_alloc->element_size();
+    void *p = reinterpret_cast<char *>(m_data) + j * m_elem_size;
     m_alloc->construct_copy(p, val);
   }
 }
@@ -45,8 +90,10 @@ fstl::vector_base::vector_base(fstl::vector_base &&other) noexcept {
   m_capacity = other.m_capacity;
   m_size = other.m_size;
   m_alloc = other.m_alloc;
+  m_elem_size = other.m_elem_size;
 
-  other.m_alloc = nullptr;
+  // The source stays usable: empty, with an adapter of its own (free if stateless).
+  other.m_alloc = m_alloc->clone();
   other.m_data = nullptr;
   other.m_capacity = 0;
   other.m_size = 0;
@@ -54,11 +101,17 @@ fstl::vector_base::vector_base(fstl::vector_base &&other) noexcept {
 
 fstl::vector_base::vector_base(const fstl::vector_base &other)
   : m_alloc(other.m_alloc->clone())
+  , m_elem_size(other.m_elem_size)
   , m_capacity(other.m_size)
   , m_size(other.m_size)
   {
   m_data = m_alloc->allocate(m_size);
-  auto elem_size = m_alloc->element_size();
+  auto elem_size = m_elem_size;
+  if (m_alloc->trivially_copyable()) {
+    if (m_size) std::memcpy(m_data, other.m_data, m_size * elem_size);
+    FSTL_INSTRUMENT_ADD(vector, copies, m_size);
+    return;
+  }
   for (size_type j = 0; j < m_size; ++j) {
     void *old_p = reinterpret_cast<char *>(other.m_data) + j * elem_size;
     void *new_p = reinterpret_cast<char *>(m_data) + j * elem_size;
@@ -67,12 +120,17 @@ fstl::vector_base::vector_base(const fstl::vector_base &other)
 }
 
 fstl::vector_base::vector_base(fstl::erased_allocator_base *alloc)
-  : m_alloc(alloc)
+  : m_alloc(detail::instrumented(alloc, instrument::container::vector))
+  , m_elem_size(alloc->element_size())
   , m_data(nullptr)
   , m_capacity(0)
   , m_size(0){}
 
-fstl::vector_base::~vector_base() { clear(); delete m_alloc; }
+fstl::vector_base::~vector_base() {
+  clear();
+  if (m_data) m_alloc->deallocate(m_data, m_capacity);
+  detail::release_adapter(m_alloc);
+}
 
 fstl::vector_base &fstl::vector_base::operator=(const fstl::vector_base &other) {
   clear();
@@ -80,8 +138,8 @@ fstl::vector_base &fstl::vector_base::operator=(const fstl::vector_base &other)
     resize(other.m_size);
   }
   for (size_type j = 0; j < other.size(); ++j) {
-    void *old_p = reinterpret_cast<char *>(other.m_data) + j * m_alloc->element_size();
-    void *new_p = reinterpret_cast<char *>(m_data) + j * m_alloc->element_size();
+    void *old_p = reinterpret_cast<char *>(other.m_data) + j * m_elem_size;
+    void *new_p = reinterpret_cast<char *>(m_data) + j * m_elem_size;
     m_alloc->construct_copy(new_p, old_p);
   }
   m_size = other.m_size;
@@ -95,16 +153,16 @@ fstl::vector_base &fstl::vector_base::operator=(fstl::vector_base &&other) {
   return *this;
 }
 
-void *fstl::vector_base::at(fstl::vector_base::size_type pos) const {
-  if (pos >= m_size) throw std::out_of_range("vector index out of range");
-  return reinterpret_cast<char *>(m_data) + pos * m_alloc->element_size();
+void fstl::vector_base::throw_out_of_range() {
+  throw std::out_of_range("vector index out of range");
 }
 
 
 
 void fstl::vector_base::push_back_copy(const void *val) {
   if (m_size == m_capacity) {
-    reserve(m_capacity * GROWTH_FACTOR + 3);
+    insert_copy(ptr_at_idx(*this, m_size), val);
+    return;
   }
   m_alloc->construct_copy(ptr_at_idx(*this, m_size), val);
   ++m_size;
@@ -120,6 +178,22 @@ void fstl::vector_base::push_back_move(void *val)
   ++m_size;
 }
 
+void *fstl::vector_base::grow_emplace_back(void *state, void (*constructor)(void *, void *))
+{
+  auto elem_size = m_elem_size;
+  size_type new_capacity = m_capacity * GROWTH_FACTOR + 3;
+  auto *new_data = static_cast<char *>(m_alloc->allocate(new_capacity));
+  auto *slot = new_data + m_size * elem_size;
+  constructor(slot, state);
+  relocate_forward(m_alloc, m_elem_size, new_data, static_cast<char *>(m_data), m_size);
+  if (m_data) FSTL_INSTRUMENT_ADD(vector, reallocations, 1);
+  if (m_data) m_alloc->deallocate(m_data, m_capacity);
+  m_data = new_data;
+  m_capacity = new_capacity;
+  ++m_size;
+  return slot;
+}
+
 void fstl::vector_base::resize(fstl::vector_base::size_type count)
 {
   auto curr_size = m_size;
@@ -156,197 +230,134 @@ void fstl::vector_base::resize_copy(fstl::vector_base::size_type count, const vo
 
 void fstl::vector_base::clear() noexcept {
   for (size_type j = 0; j < m_size; ++j) {
-    void *p = reinterpret_cast<char *>(m_data) + j * m_alloc->element_size();
+    void *p = reinterpret_cast<char *>(m_data) + j * m_elem_size;
     m_alloc->destruct(p);
   }
   m_size = 0;
 }
 
 
-void *fstl::vector_base::back() const {
-  return ptr_at_idx(*this, m_size - 1);
-}
-
 void fstl::vector_base::pop_back() {
   m_alloc->destruct(back());
   --m_size;
 }
 
 void *fstl::vector_base::erase(const void *posit) {
-  void *pos = const_cast<void *>(posit);
-  m_alloc->destruct(pos);
-  auto elem_size = m_alloc->element_size();
-  char *current = static_cast<char *>(pos);
-  char *next = static_cast<char *>(pos) + elem_size;
-  char *end = static_cast<char *>(back()) + elem_size;
-  while (next != end) {
-    m_alloc->construct_move(current, next);
-    current = next;
-    next = next + elem_size;
-  }
-  --m_size;
-  return pos;
+  return erase(posit, static_cast<const char *>(posit) + m_elem_size);
 }
+
 void *fstl::vector_base::erase(const void *begin, const void *end) {
-  auto elem_size = m_alloc->element_size();
+  auto elem_size = m_elem_size;
   char *first = static_cast<char *>(const_cast<void *>(begin));
   char *last = static_cast<char *>(const_cast<void *>(end));
-  char *vec_end = static_cast<char *>(back()) + elem_size;
-  char *it = first;
+  char *vec_end = static_cast<char *>(m_data) + m_size * elem_size;
 
-  while (it != last) {
+  for (char *it = first; it != last; it += elem_size) {
     m_alloc->destruct(it);
-    --m_size;
-    it += elem_size;
   }
+  relocate_forward(m_alloc, m_elem_size, first, last, (vec_end - last) / elem_size);
+  m_size -= (last - first) / elem_size;
+  return first;
+}
 
-  auto *next = it;
-  it = first;
+bool fstl::vector_base::owns(const void *p) const {
+  auto *begin = static_cast<const char *>(m_data);
+  auto *end = begin + m_size * m_elem_size;
+  return p >= begin && p < end;
+}
 
-  while (next != vec_end) {
-    m_alloc->construct_move(it, next);
-    it = next;
-    next = next + elem_size;
+// Opens `count` uninitialized slots at `pos`, shifting the tail (or relocating everything
+// into new storage) once. The new slots are already counted in m_size.
+char *fstl::vector_base::make_gap(const void *pos, size_type count) {
+  auto elem_size = m_elem_size;
+  auto *curr_data = static_cast<char *>(m_data);
+  size_type pos_idx = (static_cast<const char *>(pos) - curr_data) / elem_size;
+  size_type tail = m_size - pos_idx;
+
+  if (m_size + count > m_capacity) {
+    size_type new_capacity = m_capacity * GROWTH_FACTOR + 3;
+    if (new_capacity < m_size + count) new_capacity = m_size + count;
+    auto *new_data = static_cast<char *>(m_alloc->allocate(new_capacity));
+    relocate_forward(m_alloc, m_elem_size, new_data, curr_data, pos_idx);
+    relocate_forward(m_alloc, m_elem_size, new_data + (pos_idx + count) * elem_size, curr_data + pos_idx * elem_size, tail);
+    if (curr_data) FSTL_INSTRUMENT_ADD(vector, reallocations, 1);
+    if (curr_data) m_alloc->deallocate(curr_data, m_capacity);
+    m_data = new_data;
+    m_capacity = new_capacity;
+  } else {
+    relocate_backward(m_alloc, m_elem_size, curr_data + (pos_idx + count) * elem_size, curr_data + pos_idx * elem_size, tail);
   }
-  return it;
+  m_size += count;
+  return static_cast<char *>(m_data) + pos_idx * elem_size;
 }
 
-
-void *fstl::vector_base::insert_copy(const void *posit, const void *val) {
-  auto *pos = const_cast<void *>(posit);
-  auto *pos_it = static_cast<char *>(pos);
-  auto *curr_begin = static_cast<char *>(data());
-  auto elem_size = m_alloc->element_size();
-
-  size_type pos_idx = (pos_it - curr_begin) / elem_size;
-
-  auto *curr_data = m_data;
-  size_t j = 0;
-  ++m_size;
-  if (m_size > m_capacity) {
-    m_capacity = m_capacity * GROWTH_FACTOR + 3;
-    m_data = m_alloc->allocate(m_capacity);
-    for (; j < pos_idx; ++j) {
-      void *old_p = reinterpret_cast<char *>(curr_data) + j * elem_size;
-      void *new_p = reinterpret_cast<char *>(m_data) + j * elem_size;
-      m_alloc->construct_move(new_p, old_p);
-      m_alloc->destruct(old_p);
-    }
-    auto *insert_slot = reinterpret_cast<char *>(m_data) + j * elem_size;
-    m_alloc->construct_copy(insert_slot, val);
-    while (++j < m_size) {
-      void *old_p = reinterpret_cast<char *>(curr_data) + (j - 1) * elem_size;
-      void *new_p = reinterpret_cast<char *>(m_data) + j * elem_size;
-      m_alloc->construct_move(new_p, old_p);
-      m_alloc->destruct(old_p);
-    }
-    return insert_slot;
-  } else {
-    char *last = static_cast<char *>(back());
-    char *prev = last - elem_size;
-    while (prev != (pos_it - elem_size)) {
-      m_alloc->construct_move(last, prev);
-      m_alloc->destruct(prev);
-      last = prev;
-      prev -= elem_size;
-    }
-    m_alloc->construct_copy(pos_it, val);
-    return pos_it;
+void *fstl::vector_base::insert_copy(const void *pos, const void *val) {
+  if (owns(val)) {
+    // Making room moves (and may free) the source, so copy it out first.
+    auto *tmp = m_alloc->allocate(1);
+    m_alloc->construct_copy(tmp, val);
+    auto *slot = insert_move(pos, tmp);
+    m_alloc->destruct(tmp);
+    m_alloc->deallocate(tmp, 1);
+    return slot;
   }
+  auto *slot = make_gap(pos, 1);
+  m_alloc->construct_copy(slot, val);
+  return slot;
 }
 
-void *fstl::vector_base::insert_move(const void *posit, void *val) {
-  auto *pos = const_cast<void *>(posit);
-  auto *pos_it = static_cast<char *>(pos);
-  auto *curr_begin = static_cast<char *>(data());
-  auto elem_size = m_alloc->element_size();
+void *fstl::vector_base::insert_move(const void *pos, void *val) {
+  auto *slot = make_gap(pos, 1);
+  m_alloc->construct_move(slot, val);
+  return slot;
+}
 
-  size_type pos_idx = (pos_it - curr_begin) / elem_size;
+void *fstl::vector_base::insert_construct(const void *pos, void* dataptr, void (*constructor)(void *, void *)) {
+  auto *slot = make_gap(pos, 1);
+  constructor(slot, dataptr);
+  return slot;
+}
 
-  auto *curr_data = m_data;
-  size_t j = 0;
-  ++m_size;
-  if (m_size > m_capacity) {
-    m_capacity = m_capacity * GROWTH_FACTOR + 3;
-    m_data = m_alloc->allocate(m_capacity);
-    for (; j < pos_idx; ++j) {
-      void *old_p = reinterpret_cast<char *>(curr_data) + j * elem_size;
-      void *new_p = reinterpret_cast<char *>(m_data) + j * elem_size;
-      m_alloc->construct_move(new_p, old_p);
-      m_alloc->destruct(old_p);
-    }
-    auto *insert_slot = reinterpret_cast<char *>(m_data) + j * elem_size;
-    m_alloc->construct_move(insert_slot, val);
-    while (++j < m_size) {
-      void *old_p = reinterpret_cast<char *>(curr_data) + (j - 1) * elem_size;
-      void *new_p = reinterpret_cast<char *>(m_data) + j * elem_size;
-      m_alloc->construct_move(new_p, old_p);
-      m_alloc->destruct(old_p);
-    }
-    return insert_slot;
-  } else {
-    char *last = static_cast<char *>(back());
-    char *prev = last - elem_size;
-    while (prev != (pos_it - elem_size)) {
-      m_alloc->construct_move(last, prev);
-      m_alloc->destruct(prev);
-      last = prev;
-      prev -= elem_size;
-    }
-    m_alloc->construct_move(pos_it, val);
-    return pos_it;
+void *fstl::vector_base::insert_construct_n(const void *pos, size_type count, void *state,
+                                            void (*constructor)(void *, void *)) {
+  auto elem_size = m_elem_size;
+  auto *slot = make_gap(pos, count);
+  for (size_type j = 0; j < count; ++j) {
+    constructor(slot + j * elem_size, state);
   }
+  return slot;
 }
 
-void *fstl::vector_base::insert_construct(const void *posit, void* dataptr, void (*constructor)(void *, void *)) {
-  auto *pos = const_cast<void *>(posit);
-  auto *pos_it = static_cast<char *>(pos);
-  auto *curr_begin = static_cast<char *>(data());
-  auto elem_size = m_alloc->element_size();
-
-  size_type pos_idx = (pos_it - curr_begin) / elem_size;
-
-  auto *curr_data = m_data;
-  size_t j = 0;
-  ++m_size;
-  if (m_size > m_capacity) {
-    m_capacity = m_capacity * GROWTH_FACTOR + 3;
-    m_data = m_alloc->allocate(m_capacity);
-    for (; j < pos_idx; ++j) {
-      void *old_p = reinterpret_cast<char *>(curr_data) + j * elem_size;
-      void *new_p = reinterpret_cast<char *>(m_data) + j * elem_size;
-      m_alloc->construct_move(new_p, old_p);
-      m_alloc->destruct(old_p);
-    }
-    auto *insert_slot = reinterpret_cast<char *>(m_data) + j * elem_size;
-    constructor(insert_slot, dataptr);
-    while (++j < m_size) {
-      void *old_p = reinterpret_cast<char *>(curr_data) + (j - 1) * elem_size;
-      void *new_p = reinterpret_cast<char *>(m_data) + j * elem_size;
-      m_alloc->construct_move(new_p, old_p);
-      m_alloc->destruct(old_p);
-    }
-    return insert_slot;
-  } else {
-    char *last = static_cast<char *>(back());
-    char *prev = last - elem_size;
-    while (prev != (pos_it - elem_size)) {
-      m_alloc->construct_move(last, prev);
-      m_alloc->destruct(prev);
-      last = prev;
-      prev -= elem_size;
+void *fstl::vector_base::insert_copy_n(const void *pos, size_type count, const void *src) {
+  auto elem_size = m_elem_size;
+  if (count != 0 && owns(src)) {
+    // The source would be shifted or freed while making room, so stage it elsewhere.
+    auto *tmp = static_cast<char *>(m_alloc->allocate(count));
+    for (size_type j = 0; j < count; ++j) {
+      m_alloc->construct_copy(tmp + j * elem_size, static_cast<const char *>(src) + j * elem_size);
     }
-    constructor(pos_it, dataptr);
-    return pos_it;
+    auto *slot = make_gap(pos, count);
+    relocate_forward(m_alloc, m_elem_size, slot, tmp, count);
+    m_alloc->deallocate(tmp, count);
+    return slot;
+  }
+  auto *slot = make_gap(pos, count);
+  if (m_alloc->trivially_copyable()) {
+    if (count) std::memcpy(slot, src, count * elem_size);
+    FSTL_INSTRUMENT_ADD(vector, copies, count);
+    return slot;
+  }
+  for (size_type j = 0; j < count; ++j) {
+    m_alloc->construct_copy(slot + j * elem_size, static_cast<const char *>(src) + j * elem_size);
   }
+  return slot;
 }
 
-
 void fstl::vector_base::assign(fstl::vector_base::size_type count, const void *val) {
   auto *curr_data = m_data;
   if (count <= m_capacity) {
     for (size_type j = 0; j < count; ++j) {
-      void *old_p = reinterpret_cast<char *>(curr_data) + j * m_alloc->element_size();
+      void *old_p = reinterpret_cast<char *>(curr_data) + j * m_elem_size;
       m_alloc->destruct(old_p);
       m_alloc->construct_copy(old_p, val);
     }
@@ -359,15 +370,12 @@ void fstl::vector_base::reserve(fstl::vector_base::size_type count) {
   if (count <= m_capacity) {
     return;
   }
+  auto *new_storage = m_alloc->allocate(count);
+  relocate_forward(m_alloc, m_elem_size, static_cast<char *>(new_storage), static_cast<char *>(m_data), m_size);
+  if (m_data) FSTL_INSTRUMENT_ADD(vector, reallocations, 1);
+  if (m_data) m_alloc->deallocate(m_data, m_capacity);
+  m_data = new_storage;
   m_capacity = count;
-  auto curr_data = m_data;
-  auto new_storage = m_data = m_alloc->allocate(m_capacity);
-  for (size_type j = 0; j < m_size; ++j) {
-    void *old_p = reinterpret_cast<char *>(curr_data) + j * m_alloc->element_size();
-    void *new_p = reinterpret_cast<char *>(new_storage) + j * m_alloc->element_size();
-    m_alloc->construct_move(new_p, old_p);
-    m_alloc->destruct(old_p);
-  }
 }
 
 void fstl::vector_base::swap(fstl::vector_base &other) noexcept {
@@ -0,0 +1,90 @@
+#include <catch2/catch.hpp>
+
+#include "fstl/concurrent_unordered_map.h"
+
+#include <atomic>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+TEST_CASE("concurrent_unordered_map::insert_or_assign", "[concurrent_unordered_map]") {
+  fstl::concurrent_unordered_map<int, std::string> map(5);
+  REQUIRE(map.shard_count() == 8);
+
+  REQUIRE(map.insert_or_assign(1, std::string("one")));
+  REQUIRE(!map.insert_or_assign(1, std::string("uno")));
+  REQUIRE(map.size() == 1);
+
+  std::string seen;
+  REQUIRE(map.find_and_visit(1, [&](const auto &pair) { seen = pair.second; }));
+  REQUIRE(seen == "uno");
+  REQUIRE(!map.find_and_visit(2, [&](const auto &) { seen.clear(); }));
+  REQUIRE(seen == "uno");
+
+  REQUIRE(map.erase(1) == 1);
+  REQUIRE(map.erase(1) == 0);
+  REQUIRE(!map.contains(1));
+}
+
+namespace {
+// Throws once `copies_left` copies have been made, so a clone fails part way through construction.
+int copies_left = 0;
+template <class T>
+struct throwing_hash
+{
+  std::size_t salt = 0;
+  throwing_hash() = default;
+  throwing_hash(const throwing_hash &other) : salt(other.salt) {
+    if (copies_left-- == 0) throw std::runtime_error("copy");
+  }
+  std::size_t operator()(const T &key) const { return std::size_t(key) ^ salt; }
+};
+}
+
+TEST_CASE("concurrent_unordered_map::constructor_throws", "[concurrent_unordered_map]") {
+  // Leaks from the partially built map are caught by the sanitizers.
+  for (int limit : {0, 1, 3}) {
+    copies_left = limit;
+    REQUIRE_THROWS_AS((fstl::concurrent_unordered_map<int, std::string, throwing_hash<int>>(8)), std::runtime_error);
+  }
+  copies_left = 100;
+  fstl::concurrent_unordered_map<int, std::string, throwing_hash<int>> map(8);
+  REQUIRE(map.insert_or_assign(1, std::string("one")));
+  REQUIRE(map.contains(1));
+}
+
+TEST_CASE("concurrent_unordered_map::threads", "[concurrent_unordered_map]") {
+  constexpr int threads = 4;
+  constexpr int per_thread = 2000;
+  fstl::concurrent_unordered_map<int, int> map;
+  // Catch assertions are not thread safe: workers only count what they see.
+  std::atomic<int> bad_reads{0};
+
+  std::vector<std::thread> workers;
+  for (int t = 0; t < threads; ++t) {
+    workers.emplace_back([&map, &bad_reads, t] {
+      // Each thread owns a key range and also reads and updates the shared keys 0..99.
+      for (int j = 0; j < per_thread; ++j) {
+        map.insert_or_assign(1000 + t * per_thread + j, j);
+        map.insert_or_assign(j % 100, t);
+        map.find_and_visit(1000 + t * per_thread + j / 2, [&](const auto &pair) { bad_reads += pair.second < 0; });
+      }
+      for (int j = 0; j < per_thread; j += 2) map.erase(1000 + t * per_thread + j);
+    });
+  }
+  for (auto &worker : workers) worker.join();
+  REQUIRE(bad_reads == 0);
+
+  REQUIRE(map.size() == 100 + threads * per_thread / 2);
+  for (int t = 0; t < threads; ++t) {
+    for (int j = 0; j < per_thread; ++j) {
+      int value = -1;
+      bool found = map.find_and_visit(1000 + t * per_thread + j, [&](const auto &pair) { value = pair.second; });
+      REQUIRE(found == (j % 2 == 1));
+      if (found) REQUIRE(value == j);
+    }
+  }
+  map.clear();
+  REQUIRE(map.size() == 0);
+}
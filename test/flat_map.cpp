@@ -0,0 +1,212 @@
+#include <catch2/catch.hpp>
+#include <stdexcept>
+#include <string>
+
+#include "fstl/unordered_map.h"
+
+template <class Key, class Value>
+using flat_map = fstl::unordered_map<Key, Value, fstl::hash<Key>, fstl::detail::equal_to<Key>,
+                                     fstl::detail::default_allocator<fstl::pair<const Key, Value>>,
+                                     fstl::open_addressing>;
+
+static int copy = 0, move = 0, destroy = 0;
+struct tracked
+{
+  std::string s;
+  tracked() = default;
+  explicit tracked(int x) : s(std::to_string(x)) {}
+  tracked(const tracked &o) : s(o.s) { ++copy; }
+  tracked(tracked &&o) noexcept : s(std::move(o.s)) { ++move; }
+  tracked &operator =(const tracked &) = default;
+  ~tracked() { ++destroy; }
+};
+
+TEST_CASE("flat_map::operator[]", "[modifiers]") {
+  flat_map<int, int> fm(4);
+  REQUIRE(fm.size() == 0);
+  fm[1] = 1;
+  REQUIRE(fm[0] == 0);
+  REQUIRE(fm[1] == 1);
+  REQUIRE(fm.size() == 2);
+
+  // Grow well past the initial capacity
+  for (int j = 0; j < 10000; ++j) fm[j * 7] = j;
+  REQUIRE(fm.size() == 10001);
+  for (int j = 0; j < 10000; ++j) REQUIRE(fm.at(j * 7) == j);
+  REQUIRE(fm.at(1) == 1);
+  REQUIRE(fm.bucket_count() >= fm.size());
+}
+
+TEST_CASE("flat_map::find", "[lookup]") {
+  flat_map<long, int> fm;
+  for (long j = 0; j < 1000; ++j) fm.insert({j << 20, int(j)});
+  for (long j = 0; j < 1000; ++j) {
+    auto it = fm.find(j << 20);
+    REQUIRE(it != fm.end());
+    REQUIRE(it->second == j);
+    REQUIRE(fm.count((j << 20) + 1) == 0);
+  }
+  REQUIRE(fm.find(-1) == fm.end());
+  REQUIRE_THROWS_AS(fm.at(-1), std::out_of_range);
+
+  flat_map<int, int> empty(0);
+  REQUIRE(empty.find(0) == empty.end());
+  REQUIRE(empty.begin() == empty.end());
+}
+
+TEST_CASE("flat_map::iterator", "[iterators]") {
+  flat_map<int, int> fm;
+  long sum_x = 0, sum_y = 0;
+  for (int j = 0; j < 500; ++j) fm[j] = 2 * j;
+  for (auto [x, y] : fm) {
+    sum_x += x;
+    sum_y += y;
+  }
+  REQUIRE(sum_x == 499 * 500 / 2);
+  REQUIRE(sum_y == 499 * 500);
+}
+
+TEST_CASE("flat_map::emplace", "[modifiers]") {
+  flat_map<int, tracked> fm;
+  for (int j = 0; j < 100; ++j) {
+    auto [it, inserted] = fm.emplace(j, tracked{j});
+    REQUIRE(inserted);
+    REQUIRE(it->first == j);
+  }
+  auto [it, inserted] = fm.emplace(5, tracked{-1});
+  REQUIRE(!inserted);
+  REQUIRE(it->second.s == "5");
+  for (int j = 0; j < 100; ++j) REQUIRE(fm.at(j).s == std::to_string(j));
+}
+
+TEST_CASE("flat_map::emplace_from_element", "[modifiers]") {
+  // Each value is copied from an element, across every resize of the table.
+  flat_map<int, std::string> fm;
+  fm.emplace(0, std::string(40, 'x'));
+  for (int j = 1; j < 1000; ++j) fm.emplace(j, fm.at(j - 1));
+  for (int j = 0; j < 1000; ++j) REQUIRE(fm.at(j) == std::string(40, 'x'));
+}
+
+TEST_CASE("flat_map::copy", "[ctor]") {
+  flat_map<int, tracked> fm;
+  for (int j = 0; j < 100; ++j) fm[j] = tracked{j};
+  auto copied = fm;
+  REQUIRE(copied.size() == 100);
+  REQUIRE(copied.at(42).s == "42");
+
+  auto moved = std::move(copied);
+  REQUIRE(moved.size() == 100);
+  REQUIRE(copied.size() == 0);
+
+  destroy = 0;
+  moved.clear();
+  REQUIRE(moved.size() == 0);
+  REQUIRE(destroy == 100);
+  REQUIRE(moved.find(42) == moved.end());
+  moved[1] = tracked{1};
+  REQUIRE(moved.size() == 1);
+}
+
+TEST_CASE("flat_map::use_after_move", "[ctor]") {
+  flat_map<int, std::string> m;
+  m[1] = "one";
+  auto moved = std::move(m);
+  m.clear();
+  m[2] = "two";
+  REQUIRE(m.size() == 1);
+  REQUIRE(m.find(1) == m.end());
+  REQUIRE(m.at(2) == "two");
+  moved = std::move(m);
+  m.emplace(3, "three");
+  REQUIRE(m.size() == 1);
+  REQUIRE(moved.at(2) == "two");
+}
+
+TEST_CASE("flat_map::reserve", "[buckets]") {
+  flat_map<int, tracked> fm;
+  fm.reserve(1000);
+  auto capacity = fm.bucket_count();
+  REQUIRE(capacity * fm.max_load_factor() >= 1000);
+  for (int j = 0; j < 1000; ++j) fm[j] = tracked{j};
+  REQUIRE(fm.bucket_count() == capacity);
+  REQUIRE(fm.load_factor() <= fm.max_load_factor());
+
+  fm.rehash(0);
+  REQUIRE(fm.bucket_count() <= capacity);
+  REQUIRE(fm.size() == 1000);
+  for (int j = 0; j < 1000; ++j) REQUIRE(fm.at(j).s == std::to_string(j));
+}
+
+TEST_CASE("flat_map::erase", "[modifiers]") {
+  flat_map<int, tracked> fm;
+  for (int j = 0; j < 1000; ++j) fm[j] = tracked{j};
+  destroy = 0;
+  REQUIRE(fm.erase(7) == 1);
+  REQUIRE(fm.erase(7) == 0);
+  REQUIRE(destroy == 1);
+  for (auto it = fm.begin(); it != fm.end();) {
+    if (it->first % 3) {
+      it = fm.erase(it);
+    } else {
+      ++it;
+    }
+  }
+  REQUIRE(fm.size() == 334);
+  for (int j = 0; j < 1000; ++j) REQUIRE(fm.count(j) == (j % 3 == 0 ? 1 : 0));
+
+  // Churn through tombstones without growing without bound.
+  auto capacity = fm.bucket_count();
+  for (int round = 0; round < 20; ++round) {
+    for (int j = 0; j < 500; ++j) fm[10000 + j] = tracked{j};
+    for (int j = 0; j < 500; ++j) fm.erase(10000 + j);
+  }
+  REQUIRE(fm.size() == 334);
+  REQUIRE(fm.bucket_count() <= capacity * 2);
+}
+
+TEST_CASE("flat_map::merge", "[modifiers]") {
+  flat_map<int, tracked> a, b;
+  for (int j = 0; j < 100; ++j) a[j] = tracked{j};
+  for (int j = 50; j < 150; ++j) b[j] = tracked{-j};
+  a.merge(b);
+  REQUIRE(a.size() == 150);
+  REQUIRE(b.size() == 50);
+  REQUIRE(a.at(60).s == "60");
+  REQUIRE(a.at(120).s == "-120");
+  REQUIRE(b.at(60).s == "-60");
+}
+
+TEST_CASE("flat_map::stats", "[buckets]") {
+  flat_map<int, int> fm;
+  REQUIRE(fm.stats().size == 0);
+  for (int j = 0; j < 10000; ++j) fm[j] = j;
+  auto stats = fm.stats();
+  REQUIRE(stats.size == 10000);
+  REQUIRE(stats.bucket_count == fm.bucket_count());
+  REQUIRE(stats.empty_buckets == fm.bucket_count() - fm.size());
+  REQUIRE(stats.memory_bytes >= fm.bucket_count() * (2 * sizeof(int) + 1));
+  REQUIRE(stats.length_histogram[0] == 0);
+  fstl::size_t elements = 0;
+  for (auto count : stats.length_histogram) elements += count;
+  REQUIRE(elements == fm.size());
+  REQUIRE(stats.length_histogram[1] > fm.size() * 9 / 10);
+  REQUIRE(stats.uniformity > 0.5);
+  REQUIRE(stats.uniformity < 2);
+}
+
+TEST_CASE("flat_map::find_batch", "[lookup]") {
+  flat_map<int, tracked> fm;
+  for (int j = 0; j < 1000; j += 2) fm[j] = tracked{j};
+  int keys[40];
+  for (int j = 0; j < 40; ++j) keys[j] = j * 25;
+  fstl::pair<const int, tracked> *found[40];
+  bool present[40];
+  fm.find_batch(keys, 40, found);
+  fm.contains_batch(keys, 40, present);
+  for (int j = 0; j < 40; ++j) {
+    bool expected = keys[j] % 2 == 0 && keys[j] < 1000;
+    REQUIRE(present[j] == expected);
+    REQUIRE((found[j] != nullptr) == expected);
+    if (expected) REQUIRE(found[j]->second.s == std::to_string(keys[j]));
+  }
+}
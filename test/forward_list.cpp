@@ -1,4 +1,7 @@
 #include <catch2/catch.hpp>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
 
 #define TEST_STD_FL 0
 #if TEST_STD_FL
@@ -59,4 +62,111 @@ TEST_CASE("forward_list::clear", "[modifiers]") {
   ld.clear();
   REQUIRE(fl_size(ld) == 0);
   REQUIRE(destroy == 2);
-}
\ No newline at end of file
+}
+TEST_CASE("forward_list::emplace_front", "[modifiers]") {
+  struct dummy
+  {
+    int x = 0;
+    dummy(int x) : x(x) {}
+    dummy(const dummy &) { ++copy; }
+    dummy(dummy &&) noexcept { ++move; }
+  };
+  copy = move = 0;
+  forward_list<dummy> ld;
+  auto &d = ld.emplace_front(1);
+  ld.emplace_front(2);
+  REQUIRE(d.x == 1);
+  REQUIRE(ld.front().x == 2);
+  REQUIRE(copy == 0);
+  REQUIRE(move == 0);
+}
+
+TEST_CASE("forward_list::copy", "[ctor]") {
+  forward_list<int> li;
+  li.push_front(3);
+  li.push_front(2);
+  li.push_front(1);
+  forward_list<int> copied = li;
+  REQUIRE(fl_size(copied) == 3);
+  REQUIRE(copied.front() == 1);
+
+  forward_list<int> moved = std::move(copied);
+  REQUIRE(fl_size(moved) == 3);
+  REQUIRE(copied.empty());
+
+  moved = li;
+  int sum = 0;
+  for (int i : moved) sum = sum * 10 + i;
+  REQUIRE(sum == 123);
+}
+
+TEST_CASE("forward_list::use_after_move", "[ctor]") {
+  forward_list<int> li;
+  li.push_front(1);
+  forward_list<int> moved = std::move(li);
+  li.push_front(3);
+  REQUIRE(fl_size(li) == 1);
+  REQUIRE(li.front() == 3);
+  moved = std::move(li);
+  li.push_front(4);
+  REQUIRE(li.front() == 4);
+  REQUIRE(moved.front() == 3);
+}
+
+TEST_CASE("forward_list::pop_front", "[modifiers]") {
+  struct alignas(16) dummy
+  {
+    char c = 0;
+    dummy(char c) : c(c) {}
+    ~dummy() { ++destroy; }
+  };
+  forward_list<dummy> ld;
+  ld.emplace_front('a');
+  ld.emplace_front('b');
+  ld.emplace_front('c');
+  for (auto &d : ld) {
+    REQUIRE(reinterpret_cast<std::uintptr_t>(&d) % alignof(dummy) == 0);
+  }
+  destroy = 0;
+  ld.pop_front();
+  REQUIRE(destroy == 1);
+  REQUIRE(ld.front().c == 'b');
+  REQUIRE(fl_size(ld) == 2);
+}
+
+// Hands out storage aligned for T only, one byte past the previous allocation's alignment.
+template <class T>
+struct bump_allocator {
+  using value_type = T;
+  template <class U> struct rebind { using other = bump_allocator<U>; };
+
+  explicit bump_allocator(char *&cursor) : cursor(&cursor) {}
+  template <class U>
+  bump_allocator(const bump_allocator<U> &other) : cursor(other.cursor) {}
+
+  T *allocate(std::size_t n) {
+    auto addr = reinterpret_cast<std::uintptr_t>(*cursor) + 1;
+    addr = (addr + alignof(T) - 1) / alignof(T) * alignof(T);
+    *cursor = reinterpret_cast<char *>(addr + n * sizeof(T));
+    return reinterpret_cast<T *>(addr);
+  }
+  void deallocate(T *, std::size_t) {}
+
+  char **cursor;
+};
+
+TEST_CASE("forward_list::node_alignment", "[allocator]") {
+#if !TEST_STD_FL
+  alignas(16) static char arena[4096];
+  char *cursor = arena;
+  fstl::forward_list<char, bump_allocator<char>> lc(0, bump_allocator<char>(cursor));
+  for (char c = 'a'; c <= 'z'; ++c) lc.push_front(c);
+  int count = 0;
+  for (auto &c : lc) {
+    REQUIRE(reinterpret_cast<std::uintptr_t>(&c) % alignof(std::max_align_t) == 0);
+    REQUIRE(c == 'z' - count++);
+  }
+  REQUIRE(count == 26);
+  REQUIRE(cursor > arena);
+#endif
+}
@@ -0,0 +1,93 @@
+#include <catch2/catch.hpp>
+
+#include "fstl/frozen_map.h"
+
+#include <functional>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+
+TEST_CASE("frozen_map::from_unordered_map", "[frozen_map]") {
+  fstl::unordered_map<int, std::string> source;
+  for (int j = 0; j < 10000; ++j) source[j * 7] = std::to_string(j);
+
+  fstl::frozen_map<int, std::string> frozen(source);
+  REQUIRE(frozen.size() == 10000);
+  for (int j = 0; j < 10000; ++j) REQUIRE(frozen.at(j * 7) == std::to_string(j));
+  for (int j = 0; j < 10000; ++j) REQUIRE(!frozen.contains(j * 7 + 1));
+  REQUIRE_THROWS_AS(frozen.at(-1), std::out_of_range);
+
+  long sum = 0;
+  for (auto &pair : frozen) sum += pair.first;
+  REQUIRE(sum == 7l * 9999 * 10000 / 2);
+}
+
+TEST_CASE("frozen_map::from_vector", "[frozen_map]") {
+  fstl::vector<fstl::pair<std::string, int>> pairs;
+  pairs.push_back({"content-length", 1});
+  pairs.push_back({"content-type", 2});
+  pairs.push_back({"host", 3});
+  pairs.push_back({"host", 4});
+
+  fstl::frozen_map<std::string, int> frozen(pairs);
+  REQUIRE(frozen.size() == 3);
+  REQUIRE(frozen.at("content-length") == 1);
+  REQUIRE(frozen.at("content-type") == 2);
+  REQUIRE(frozen.at("host") == 3);
+  REQUIRE(frozen.find("accept") == nullptr);
+
+  fstl::frozen_map<std::string, int> empty(fstl::vector<fstl::pair<std::string, int>>{});
+  REQUIRE(empty.empty());
+  REQUIRE(!empty.contains("host"));
+}
+
+// Keys that all hash the same can never be told apart.
+template <class T>
+struct constant_hash {
+  size_t operator()(const T &) const { return 42; }
+};
+
+TEST_CASE("frozen_map::no_perfect_hash", "[frozen_map]") {
+  fstl::vector<fstl::pair<int, int>> pairs;
+  pairs.push_back({1, 1});
+  pairs.push_back({2, 2});
+  using map_type = fstl::frozen_map<int, int, constant_hash<int>>;
+  REQUIRE_THROWS_AS(map_type(pairs), std::invalid_argument);
+}
+
+TEST_CASE("frozen_map::identity_hash", "[frozen_map]") {
+  // std::hash<int> leaves small keys without high bits, which must not all share a bucket.
+  fstl::vector<fstl::pair<int, int>> pairs;
+  for (int j = 0; j < 200; ++j) pairs.push_back({j * 3, j});
+  fstl::frozen_map<int, int, std::hash<int>> frozen(pairs);
+  REQUIRE(frozen.size() == 200);
+  for (int j = 0; j < 200; ++j) REQUIRE(frozen.at(j * 3) == j);
+  REQUIRE(frozen.find(1) == nullptr);
+}
+
+enum class field { length, type, host, accept };
+
+constexpr auto fields = fstl::make_frozen_map<std::string_view, field>({
+  {"content-length", field::length},
+  {"content-type", field::type},
+  {"host", field::host},
+  {"accept", field::accept},
+});
+
+static_assert(fields.size() == 4);
+static_assert(fields.at("host") == field::host);
+static_assert(fields.at("accept") == field::accept);
+static_assert(!fields.contains("cookie"));
+
+TEST_CASE("frozen_map::constexpr", "[frozen_map]") {
+  // Built by the compiler, looked up at run time with the same hash.
+  std::string key = "content-type";
+  REQUIRE(fields.at(key) == field::type);
+  REQUIRE(fields.find(std::string("content")) == nullptr);
+  REQUIRE(fstl::hash<std::string_view>{}(key) == fstl::detail::hash_bytes(key.data(), key.size()));
+
+  constexpr fstl::pair<int, int> squares[] = {{1, 1}, {2, 4}, {3, 9}, {4, 16}, {5, 25}, {6, 36}, {7, 49}, {8, 64}};
+  constexpr auto table = fstl::make_frozen_map(squares);
+  static_assert(table.at(7) == 49);
+  for (auto &pair : table) REQUIRE(table.at(pair.first) == pair.first * pair.first);
+}
@@ -0,0 +1,133 @@
+#include <catch2/catch.hpp>
+
+#include "fstl/functional/hash.h"
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+static uint64_t splitmix64(uint64_t &state)
+{
+  uint64_t z = (state += 0x9E3779B97F4A7C15ull);
+  z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+  z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+  return z ^ (z >> 31);
+}
+
+// Flips every input bit of random inputs and checks that each output bit then flips about
+// half of the time.
+template <class Hash>
+static void check_avalanche(int input_bits, Hash &&hash_of)
+{
+  constexpr int samples = 2000;
+  std::vector<int> flips(input_bits * 64);
+  uint64_t state = 1;
+  for (int s = 0; s < samples; ++s) {
+    unsigned char input[32];
+    for (int j = 0; j < 32; j += 8) {
+      auto r = splitmix64(state);
+      memcpy(input + j, &r, 8);
+    }
+    auto h = hash_of(input);
+    for (int bit = 0; bit < input_bits; ++bit) {
+      input[bit / 8] ^= 1 << (bit % 8);
+      auto diff = h ^ hash_of(input);
+      input[bit / 8] ^= 1 << (bit % 8);
+      for (int out = 0; out < 64; ++out) flips[bit * 64 + out] += (diff >> out) & 1;
+    }
+  }
+  int worst = 0;
+  for (int f : flips) {
+    int bias = f > samples / 2 ? f - samples / 2 : samples / 2 - f;
+    worst = bias > worst ? bias : worst;
+  }
+  // Within 0.5 +- 0.1.
+  REQUIRE(worst < samples / 10);
+}
+
+TEST_CASE("hash::avalanche_int", "[hash]") {
+  check_avalanche(64, [](const unsigned char *in) {
+    uint64_t v;
+    memcpy(&v, in, 8);
+    return fstl::hash<uint64_t>{}(v);
+  });
+}
+
+TEST_CASE("hash::avalanche_bytes", "[hash]") {
+  for (int len : {3, 8, 13, 32}) {
+    check_avalanche(len * 8, [len](const unsigned char *in) { return fstl::detail::hash_bytes(in, len); });
+  }
+}
+
+// Keys that differ only in high bits must still spread over the low bits that a
+// power-of-two table indexes with.
+TEST_CASE("hash::low_bits", "[hash]") {
+  constexpr uint64_t buckets = 1 << 16;
+  std::unordered_set<uint64_t> used;
+  for (uint64_t j = 0; j < buckets; ++j) {
+    used.insert(fstl::hash<uint64_t>{}(j << 32) & (buckets - 1));
+  }
+  // A random function fills 1 - 1/e of the buckets.
+  REQUIRE(used.size() > buckets * 6 / 10);
+
+  used.clear();
+  for (uint64_t j = 0; j < buckets; ++j) {
+    used.insert(fstl::hash<std::string>{}("key" + std::to_string(j)) & (buckets - 1));
+  }
+  REQUIRE(used.size() > buckets * 6 / 10);
+}
+
+TEST_CASE("hash::collisions", "[hash]") {
+  std::unordered_set<size_t> seen;
+  int collisions = 0;
+  for (int j = 0; j < 100000; ++j) {
+    collisions += !seen.insert(fstl::hash<int>{}(j)).second;
+    collisions += !seen.insert(fstl::hash<std::string>{}(std::to_string(j) + "/item")).second;
+  }
+  REQUIRE(collisions == 0);
+}
+
+TEST_CASE("hash::string_like", "[hash]") {
+  std::string a = "a string long enough to take the bulk path of the byte hash, twice over.";
+  std::string b = a;
+  REQUIRE(fstl::hash<std::string>{}(a) == fstl::hash<std::string>{}(b));
+  b.back() = '!';
+  REQUIRE(fstl::hash<std::string>{}(a) != fstl::hash<std::string>{}(b));
+  REQUIRE(fstl::hash<std::string>{}(a) == fstl::detail::hash_bytes(a.data(), a.size()));
+  REQUIRE(fstl::hash<std::string>{}("") == fstl::detail::hash_bytes(nullptr, 0));
+}
+
+TEST_CASE("hash::floating_point", "[hash]") {
+  // Equal keys hash the same, whatever their bit patterns.
+  REQUIRE(fstl::hash<double>{}(0.0) == fstl::hash<double>{}(-0.0));
+  REQUIRE(fstl::hash<float>{}(0.0f) == fstl::hash<float>{}(-0.0f));
+  REQUIRE(fstl::hash<long double>{}(0.0L) == fstl::hash<long double>{}(-0.0L));
+  REQUIRE(fstl::hash<double>{}(1.5) != fstl::hash<double>{}(-1.5));
+  REQUIRE(fstl::hash<double>{}(0.1 + 0.2) != fstl::hash<double>{}(0.3));
+
+  // Only the value bytes of a long double count, not the padding after them.
+  long double a, b;
+  memset(&a, 0x00, sizeof(a));
+  memset(&b, 0xff, sizeof(b));
+  a = 2.5L;
+  b = 2.5L;
+  REQUIRE(fstl::hash<long double>{}(a) == fstl::hash<long double>{}(b));
+}
+
+TEST_CASE("hash::contiguous_elements", "[hash]") {
+  // Equal elements with different bytes: strings on the heap, and zeros of both signs.
+  std::vector<std::string> a = {"first", "second"}, b = a;
+  REQUIRE(fstl::hash<std::vector<std::string>>{}(a) == fstl::hash<std::vector<std::string>>{}(b));
+  b.back() = "other";
+  REQUIRE(fstl::hash<std::vector<std::string>>{}(a) != fstl::hash<std::vector<std::string>>{}(b));
+
+  std::vector<double> x = {1.0, 0.0}, y = {1.0, -0.0};
+  REQUIRE(fstl::hash<std::vector<double>>{}(x) == fstl::hash<std::vector<double>>{}(y));
+  REQUIRE(fstl::hash<std::vector<double>>{}(x) != fstl::hash<std::vector<double>>{}(std::vector<double>{0.0, 1.0}));
+
+  // Elements without padding still hash as one block of bytes.
+  std::vector<int> v = {1, 2, 3};
+  REQUIRE(fstl::hash<std::vector<int>>{}(v) == fstl::detail::hash_bytes(v.data(), v.size() * sizeof(int)));
+}
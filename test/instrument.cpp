@@ -0,0 +1,97 @@
+#include <catch2/catch.hpp>
+#include <cstdio>
+#include <string>
+
+#include "fstl/instrument.h"
+#include "fstl/string_containers.h"
+
+using fstl::instrument::container;
+
+TEST_CASE("instrument::vector", "[instrument]") {
+  fstl::instrument::reset();
+  {
+    fstl::vector<std::string> v;
+    for (int j = 0; j < 100; ++j) v.push_back(std::to_string(j));
+    auto copy = v;
+    v.erase(v.begin());
+  }
+  auto stats = fstl::instrument::snapshot(container::vector);
+  if (!fstl::instrument::enabled) {
+    REQUIRE(stats.allocations == 0);
+    REQUIRE(stats.copies == 0);
+    return;
+  }
+  REQUIRE(stats.allocations > 1);
+  REQUIRE(stats.allocations == stats.deallocations);
+  REQUIRE(stats.allocated_bytes == stats.freed_bytes);
+  REQUIRE(stats.reallocations == stats.allocations - 2);
+  REQUIRE(stats.copies == 100);
+  REQUIRE(stats.moves >= 100);
+  REQUIRE(stats.destructs == stats.copies + stats.moves);
+  REQUIRE(fstl::instrument::snapshot(container::unordered_map).allocations == 0);
+}
+
+TEST_CASE("instrument::trivial_relocation", "[instrument]") {
+  fstl::instrument::reset();
+  {
+    fstl::vector<int> v;
+    v.reserve(10);
+    for (int j = 0; j < 10; ++j) v.push_back(j);
+    v.reserve(20);
+  }
+  auto stats = fstl::instrument::snapshot(container::vector);
+  if (!fstl::instrument::enabled) return;
+  // Relocated with memmove, but counted all the same.
+  REQUIRE(stats.moves == 10);
+  REQUIRE(stats.reallocations == 1);
+}
+
+TEST_CASE("instrument::unordered_map", "[instrument]") {
+  fstl::instrument::reset();
+  {
+    fstl::unordered_map<int, int> m;
+    for (int j = 0; j < 1000; ++j) m[j] = j;
+    for (int j = 0; j < 2000; ++j) (void)m.count(j);
+  }
+  auto stats = fstl::instrument::snapshot(container::unordered_map);
+  if (!fstl::instrument::enabled) return;
+  REQUIRE(stats.hash_calls >= 3000);
+  REQUIRE(stats.lookups >= 2000);
+  REQUIRE(stats.max_probe >= 1);
+  REQUIRE(stats.probes >= stats.max_probe);
+  REQUIRE(stats.rehashes > 0);
+  REQUIRE(stats.allocations == stats.deallocations);
+  REQUIRE(stats.destructs == 1000);
+}
+
+TEST_CASE("instrument::flat_map", "[instrument]") {
+  fstl::instrument::reset();
+  {
+    fstl::unordered_map<int, int, fstl::hash<int>, fstl::detail::equal_to<int>,
+                        fstl::detail::default_allocator<fstl::pair<const int, int>>, fstl::open_addressing> m;
+    for (int j = 0; j < 1000; ++j) m[j] = j;
+    REQUIRE(m.find(-1) == m.end());
+  }
+  auto stats = fstl::instrument::snapshot(container::flat_map);
+  if (!fstl::instrument::enabled) return;
+  REQUIRE(stats.lookups >= 1001);
+  REQUIRE(stats.rehashes > 0);
+  REQUIRE(stats.rehashes == stats.reallocations);
+  REQUIRE(stats.allocations == stats.deallocations);
+}
+
+TEST_CASE("instrument::report", "[instrument]") {
+  fstl::instrument::reset();
+  fstl::vector<int> v(3);
+  auto path = std::string(std::tmpnam(nullptr));
+  REQUIRE(fstl::instrument::report(path.c_str()));
+  std::FILE *in = std::fopen(path.c_str(), "r");
+  REQUIRE(in);
+  char line[256] = {};
+  REQUIRE(std::fgets(line, sizeof(line), in));
+  std::fclose(in);
+  std::remove(path.c_str());
+  REQUIRE(std::string(line).find("fstl counters") == 0);
+  REQUIRE((std::string(line).find("vector") != std::string::npos) == fstl::instrument::enabled);
+  REQUIRE_FALSE(fstl::instrument::report("/nonexistent/dir/report"));
+}
@@ -0,0 +1,52 @@
+#include <catch2/catch.hpp>
+
+#include "fstl/forward_list.h"
+#include "fstl/node_pool.h"
+#include "fstl/unordered_map.h"
+
+TEST_CASE("node_pool::reuse", "[allocator]") {
+  fstl::node_pool pool(24, 4);
+  void *a = pool.allocate();
+  void *b = pool.allocate();
+  REQUIRE(a != b);
+  REQUIRE(pool.slab_count() == 1);
+  pool.deallocate(a);
+  REQUIRE(pool.allocate() == a);
+
+  for (int j = 0; j < 3; ++j) pool.allocate();
+  REQUIRE(pool.slab_count() == 2);
+}
+
+TEST_CASE("node_pool::forward_list", "[allocator]") {
+  fstl::forward_list<int, fstl::pool_allocator<int>> li;
+  for (int j = 0; j < 1000; ++j) li.push_front(j);
+  for (int j = 0; j < 500; ++j) li.pop_front();
+  for (int j = 0; j < 500; ++j) li.push_front(j);
+  int count = 0;
+  for (int i : li) count += i >= 0;
+  REQUIRE(count == 1000);
+
+  auto copied = li;
+  REQUIRE(copied.front() == li.front());
+}
+
+TEST_CASE("node_pool::shared", "[allocator]") {
+  using pair_type = fstl::pair<const int, int>;
+  using map = fstl::unordered_map<int, int, fstl::hash<int>, fstl::detail::equal_to<int>,
+                                  fstl::pool_allocator<pair_type>>;
+  fstl::node_pool pool(fstl::detail::ll_node_header_size + sizeof(pair_type));
+  {
+    map m1(16, {}, {}, fstl::pool_allocator<pair_type>(pool));
+    map m2(16, {}, {}, fstl::pool_allocator<pair_type>(pool));
+    for (int j = 0; j < 300; ++j) {
+      m1[j] = j;
+      m2[j] = -j;
+    }
+    REQUIRE(pool.slab_count() == 3);
+    REQUIRE(m1.at(42) == 42);
+    REQUIRE(m2.at(42) == -42);
+  }
+  // The containers gave their nodes back for reuse.
+  for (int j = 0; j < 600; ++j) pool.allocate();
+  REQUIRE(pool.slab_count() == 3);
+}
@@ -0,0 +1,182 @@
+#include <catch2/catch.hpp>
+#include <stdexcept>
+#include <string>
+
+#include "fstl/unordered_map.h"
+
+template <class Key, class Value, class Hash = fstl::hash<Key>>
+using robin_hood_map = fstl::unordered_map<Key, Value, Hash, fstl::detail::equal_to<Key>,
+                                           fstl::detail::default_allocator<fstl::pair<const Key, Value>>,
+                                           fstl::robin_hood>;
+
+struct counted
+{
+  std::string s;
+  counted() = default;
+  explicit counted(int x) : s(std::to_string(x)) {}
+};
+
+TEST_CASE("robin_hood_map::operator[]", "[modifiers]") {
+  robin_hood_map<int, int> rm(4);
+  rm[1] = 1;
+  REQUIRE(rm[0] == 0);
+  REQUIRE(rm[1] == 1);
+  REQUIRE(rm.size() == 2);
+
+  for (int j = 0; j < 10000; ++j) rm[j * 7] = j;
+  REQUIRE(rm.size() == 10001);
+  for (int j = 0; j < 10000; ++j) REQUIRE(rm.at(j * 7) == j);
+  for (int j = 0; j < 10000; ++j) REQUIRE(rm.count(j * 7 + 1) == (j * 7 + 1 == 1 ? 1 : 0));
+  REQUIRE_THROWS_AS(rm.at(-1), std::out_of_range);
+
+  robin_hood_map<int, int> empty(0);
+  REQUIRE(empty.find(0) == empty.end());
+  REQUIRE(empty.begin() == empty.end());
+}
+
+TEST_CASE("robin_hood_map::max_probe_length", "[buckets]") {
+  robin_hood_map<long, counted> rm;
+  rm.max_load_factor(0.95f);
+  REQUIRE(rm.max_load_factor() == 0.95f);
+  rm.reserve(100000);
+  auto capacity = rm.bucket_count();
+  for (long j = 0; j < 100000; ++j) rm[j << 12] = counted{int(j)};
+  REQUIRE(rm.bucket_count() == capacity);
+  REQUIRE(rm.load_factor() > 0.75f);
+  // Robin hood keeps the longest probe close to the logarithm of the size.
+  REQUIRE(rm.max_probe_length() <= 48);
+  for (long j = 0; j < 100000; ++j) REQUIRE(rm.at(j << 12).s == std::to_string(j));
+
+  rm.max_load_factor(2.f);
+  REQUIRE(rm.max_load_factor() == 0.95f);
+}
+
+TEST_CASE("robin_hood_map::use_after_move", "[ctor]") {
+  robin_hood_map<int, std::string> m;
+  m[1] = "one";
+  auto moved = std::move(m);
+  m.clear();
+  m[2] = "two";
+  REQUIRE(m.size() == 1);
+  REQUIRE(m.find(1) == m.end());
+  REQUIRE(m.at(2) == "two");
+  moved = std::move(m);
+  m.emplace(3, "three");
+  REQUIRE(m.size() == 1);
+  REQUIRE(moved.at(2) == "two");
+}
+
+TEST_CASE("robin_hood_map::erase", "[modifiers]") {
+  robin_hood_map<int, counted> rm;
+  for (int j = 0; j < 1000; ++j) rm[j] = counted{j};
+  REQUIRE(rm.erase(7) == 1);
+  REQUIRE(rm.erase(7) == 0);
+  int visited = 0;
+  for (auto it = rm.begin(); it != rm.end();) {
+    ++visited;
+    if (it->first % 3) {
+      it = rm.erase(it);
+    } else {
+      ++it;
+    }
+  }
+  // Backward shifts never move an element in front of the iterator.
+  REQUIRE(visited == 999);
+  REQUIRE(rm.size() == 334);
+  for (int j = 0; j < 1000; ++j) REQUIRE(rm.count(j) == (j % 3 == 0 ? 1 : 0));
+
+  // No tombstones: churn leaves the table as it was.
+  auto capacity = rm.bucket_count();
+  auto probe = rm.max_probe_length();
+  for (int round = 0; round < 20; ++round) {
+    for (int j = 0; j < 500; ++j) rm[10000 + j] = counted{j};
+    for (int j = 0; j < 500; ++j) rm.erase(10000 + j);
+  }
+  REQUIRE(rm.size() == 334);
+  REQUIRE(rm.bucket_count() == capacity);
+  REQUIRE(rm.max_probe_length() == probe);
+}
+
+TEST_CASE("robin_hood_map::emplace", "[modifiers]") {
+  robin_hood_map<int, counted> rm;
+  for (int j = 0; j < 100; ++j) REQUIRE(rm.emplace(j, counted{j}).second);
+  auto [it, inserted] = rm.emplace(5, counted{-1});
+  REQUIRE(!inserted);
+  REQUIRE(it->second.s == "5");
+
+  auto copied = rm;
+  REQUIRE(copied.size() == 100);
+  for (int j = 0; j < 100; ++j) REQUIRE(copied.at(j).s == std::to_string(j));
+}
+
+TEST_CASE("robin_hood_map::emplace_from_element", "[modifiers]") {
+  // Each value is copied from an element, across every resize of the table.
+  robin_hood_map<int, std::string> rm;
+  rm.emplace(0, std::string(40, 'x'));
+  for (int j = 1; j < 1000; ++j) rm.emplace(j, rm.at(j - 1));
+  for (int j = 0; j < 1000; ++j) REQUIRE(rm.at(j) == std::string(40, 'x'));
+}
+
+TEST_CASE("robin_hood_map::merge", "[modifiers]") {
+  robin_hood_map<int, counted> a, b;
+  for (int j = 0; j < 100; ++j) a[j] = counted{j};
+  for (int j = 50; j < 150; ++j) b[j] = counted{-j};
+  a.merge(b);
+  REQUIRE(a.size() == 150);
+  REQUIRE(b.size() == 50);
+  REQUIRE(a.at(120).s == "-120");
+  for (int j = 50; j < 100; ++j) REQUIRE(b.at(j).s == std::to_string(-j));
+}
+
+// Keys that all hash the same can never be spread out by growing.
+template <class T>
+struct constant_hash {
+  size_t operator()(const T &) const { return 42; }
+};
+
+TEST_CASE("robin_hood_map::equal_hashes", "[modifiers]") {
+  robin_hood_map<int, int, constant_hash<int>> rm;
+  for (int j = 0; j < 200; ++j) rm[j] = j;
+  for (int j = 0; j < 200; ++j) REQUIRE(rm.at(j) == j);
+  REQUIRE(rm.max_probe_length() == 200);
+  REQUIRE_THROWS_AS([&] { for (int j = 200; j < 1000; ++j) rm[j] = j; }(), std::length_error);
+  // The table that could not grow is left as it was.
+  REQUIRE(rm.size() == 255);
+  for (int j = 0; j < 255; ++j) REQUIRE(rm.at(j) == j);
+}
+
+// Runs of 150 keys with equal hashes: growing to the next capacity is not always enough.
+template <class T>
+struct run_hash {
+  size_t operator()(const T &key) const { return size_t(key / 150); }
+};
+
+TEST_CASE("robin_hood_map::clustered_hashes", "[modifiers]") {
+  robin_hood_map<int, std::string, run_hash<int>> rm;
+  for (int j = 0; j < 20000; ++j) rm.emplace(j, std::to_string(j));
+  REQUIRE(rm.size() == 20000);
+  REQUIRE(rm.max_probe_length() <= fstl::detail::robin_hood_map_base::max_probe_limit);
+  for (int j = 0; j < 20000; ++j) REQUIRE(rm.at(j) == std::to_string(j));
+}
+
+TEST_CASE("robin_hood_map::stats", "[buckets]") {
+  robin_hood_map<int, int> rm;
+  for (int j = 0; j < 10000; ++j) rm[j] = j;
+  auto stats = rm.stats();
+  REQUIRE(stats.size == 10000);
+  REQUIRE(stats.bucket_count == rm.bucket_count());
+  REQUIRE(stats.max_length == rm.max_probe_length());
+  REQUIRE(stats.length_histogram[0] == 0);
+  fstl::size_t elements = 0;
+  for (auto count : stats.length_histogram) elements += count;
+  REQUIRE(elements == rm.size());
+  REQUIRE(stats.uniformity > 0.5);
+  REQUIRE(stats.uniformity < 2);
+
+  robin_hood_map<int, int, constant_hash<int>> clustered;
+  for (int j = 0; j < 100; ++j) clustered[j] = j;
+  stats = clustered.stats();
+  REQUIRE(stats.max_length == 100);
+  REQUIRE(stats.length_histogram[stats.histogram_size - 1] == 86);
+  REQUIRE(stats.uniformity > 10);
+}
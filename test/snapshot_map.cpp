@@ -0,0 +1,76 @@
+#include <catch2/catch.hpp>
+
+#include "fstl/snapshot_map.h"
+
+#include <atomic>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+TEST_CASE("snapshot_map::from_unordered_map", "[snapshot_map]") {
+  fstl::unordered_map<int, std::string> source;
+  for (int j = 0; j < 1000; ++j) source[j] = std::to_string(j);
+
+  fstl::snapshot_map<int, std::string> snapshot(source);
+  source.clear();
+  REQUIRE(snapshot.size() == 1000);
+  REQUIRE(snapshot.bucket_count() == 1024);
+  for (int j = 0; j < 1000; ++j) REQUIRE(snapshot.at(j) == std::to_string(j));
+  REQUIRE(snapshot.find(1000) == nullptr);
+  REQUIRE(!snapshot.contains(-1));
+  REQUIRE_THROWS_AS(snapshot.at(1000), std::out_of_range);
+
+  long sum = 0;
+  for (auto &pair : snapshot) sum += pair.first;
+  REQUIRE(sum == 999 * 1000 / 2);
+}
+
+TEST_CASE("snapshot_map::from_vector", "[snapshot_map]") {
+  fstl::vector<fstl::pair<std::string, int>> pairs;
+  pairs.push_back({"a", 1});
+  pairs.push_back({"b", 2});
+  pairs.push_back({"a", 3});
+
+  fstl::snapshot_map<std::string, int> snapshot(pairs);
+  REQUIRE(snapshot.size() == 2);
+  REQUIRE(snapshot.at("a") == 1);
+  REQUIRE(snapshot.at("b") == 2);
+
+  fstl::snapshot_map<std::string, int> empty(fstl::vector<fstl::pair<std::string, int>>{});
+  REQUIRE(empty.empty());
+  REQUIRE(empty.find("a") == nullptr);
+  REQUIRE(empty.begin() == empty.end());
+}
+
+TEST_CASE("snapshot_map::rcu_cell", "[snapshot_map]") {
+  using table = fstl::snapshot_map<int, int>;
+  auto build = [](int version) {
+    fstl::vector<fstl::pair<int, int>> pairs;
+    for (int j = 0; j < 64; ++j) pairs.push_back({j, version});
+    return new table(pairs);
+  };
+
+  fstl::rcu_cell<table> cell(build(0));
+  std::atomic<bool> done{false};
+  // Catch assertions are not thread safe: readers only count what they see.
+  std::atomic<int> torn{0};
+  std::vector<std::thread> readers;
+  for (int t = 0; t < 3; ++t) {
+    readers.emplace_back([&] {
+      while (!done) {
+        cell.read([&](const table *snapshot) {
+          // Every element of one snapshot has the same version.
+          int version = snapshot->at(0);
+          for (auto &pair : *snapshot) torn += pair.second != version;
+        });
+      }
+    });
+  }
+  for (int version = 1; version <= 200; ++version) cell.publish(build(version));
+  done = true;
+  for (auto &reader : readers) reader.join();
+
+  REQUIRE(torn == 0);
+  REQUIRE(cell.read([](const table *snapshot) { return snapshot->at(63); }) == 200);
+}
@@ -1,5 +1,9 @@
 #include <catch2/catch.hpp>
 #include <stdexcept>
+#include <string>
+#include <string_view>
+#include <memory>
+#include <vector>
 
 #define TEST_STD_UM 0
 #if TEST_STD_UM
@@ -8,6 +12,7 @@
 using std::unordered_map;
 #else
 
+#include "fstl/node_pool.h"
 #include "fstl/unordered_map.h"
 using fstl::unordered_map;
 #endif
@@ -99,6 +104,12 @@ TEST_CASE("unordered_map::find", "[lookup]") {
   REQUIRE(it2 != umii.end());
   REQUIRE(it2->first == 5);
   REQUIRE(it2->second == 5);
+
+  // 0.0 == -0.0, so they are the same key.
+  unordered_map<double, int> umdi;
+  umdi[0.0] = 1;
+  REQUIRE(umdi.find(-0.0) != umdi.end());
+  REQUIRE(umdi.size() == 1);
 }
 
 
@@ -106,9 +117,151 @@ TEST_CASE("unordered_map::bucket_size", "[buckets]") {
   unordered_map<int, int> umii(1);
   umii[0] = 5;
   umii[5] = 10;
-  REQUIRE(umii.bucket_size(0) == 2);
+  size_t total = 0;
+  for (size_t j = 0; j < umii.bucket_count(); ++j) {
+    total += umii.bucket_size(j);
+  }
+  REQUIRE(total == 2);
+}
+
+TEST_CASE("unordered_map::load_factor", "[buckets]") {
+  unordered_map<int, int> umii(4);
+  REQUIRE(umii.load_factor() == 0.f);
+  for (int j = 0; j < 1000; ++j) {
+    umii[j] = j;
+    REQUIRE(umii.load_factor() <= umii.max_load_factor());
+  }
+  REQUIRE(umii.bucket_count() >= 1000);
+
+  umii.max_load_factor(0.25f);
+  REQUIRE(umii.bucket_count() >= 4000);
+  for (int j = 0; j < 1000; ++j) {
+    REQUIRE(umii.at(j) == j);
+  }
+}
+
+TEST_CASE("unordered_map::rehash", "[buckets]") {
+  unordered_map<int, int> umii(2);
+  for (int j = 0; j < 100; ++j) {
+    umii[j] = j;
+  }
+  auto *first = &umii.at(42);
+  umii.rehash(5000);
+  REQUIRE(umii.bucket_count() >= 5000);
+  // Nodes are relinked, not reallocated.
+  REQUIRE(&umii.at(42) == first);
+
+  umii.rehash(0);
+  REQUIRE(umii.bucket_count() >= 100);
+  REQUIRE(umii.size() == 100);
+  int sum = 0;
+  for (auto [k, v] : umii) {
+    sum += v;
+  }
+  REQUIRE(sum == 4950);
+}
+
+TEST_CASE("unordered_map::reserve", "[buckets]") {
+  unordered_map<int, int> umii(1);
+  umii.reserve(300);
+  auto buckets = umii.bucket_count();
+  REQUIRE(buckets >= 300);
+  for (int j = 0; j < 300; ++j) {
+    umii[j] = j;
+  }
+  REQUIRE(umii.bucket_count() == buckets);
+}
+
+TEST_CASE("unordered_map::sparse_iteration", "[iterators]") {
+  // Few elements spread over many buckets, some past the first bitmap words.
+  unordered_map<int, int> umii(1 << 16);
+  int keys[] = {0, 63, 64, 1000, 65535, 70000};
+  for (int key : keys) umii[key] = key;
+  long sum = 0;
+  int visited = 0;
+  for (auto [k, v] : umii) {
+    sum += v;
+    ++visited;
+  }
+  REQUIRE(visited == 6);
+  REQUIRE(sum == 0 + 63 + 64 + 1000 + 65535 + 70000);
+
+  for (auto it = umii.begin(); it != umii.end();) {
+    if (it->first % 2) {
+      it = umii.erase(it);
+    } else {
+      ++it;
+    }
+  }
+  REQUIRE(umii.size() == 4);
+  umii.erase(0);
+  umii.erase(64);
+  umii.erase(1000);
+  REQUIRE(umii.begin()->first == 70000);
+  umii.erase(70000);
+  REQUIRE(umii.begin() == umii.end());
+
+  umii[5] = 5;
+  umii.clear();
+  REQUIRE(umii.begin() == umii.end());
+}
+
+#if !TEST_STD_UM
+TEST_CASE("unordered_map::bucket_policy", "[buckets]") {
+  unordered_map<int, int> umii(10);
+  REQUIRE(umii.bucket_policy() == fstl::bucket_policy::power_of_two);
+  for (int j = 0; j < 500; ++j) {
+    umii[j * 3] = j;
+  }
+  auto buckets = umii.bucket_count();
+  REQUIRE((buckets & (buckets - 1)) == 0);
+
+  umii.bucket_policy(fstl::bucket_policy::prime);
+  REQUIRE(umii.bucket_count() % 2 == 1);
+  for (int j = 0; j < 500; ++j) {
+    REQUIRE(umii.at(j * 3) == j);
+  }
 }
 
+template <class T>
+struct one_bucket_hash {
+  size_t operator()(const T &) const { return 42; }
+};
+
+TEST_CASE("unordered_map::stats", "[buckets]") {
+  unordered_map<int, int> umii;
+  auto stats = umii.stats();
+  REQUIRE(stats.size == 0);
+  REQUIRE(stats.uniformity == 0);
+
+  for (int j = 0; j < 10000; ++j) umii[j * 7] = j;
+  stats = umii.stats();
+  REQUIRE(stats.size == 10000);
+  REQUIRE(stats.bucket_count == umii.bucket_count());
+  REQUIRE(stats.load_factor == umii.load_factor());
+  REQUIRE(stats.memory_bytes > 10000 * 2 * sizeof(int));
+  fstl::size_t buckets = 0, elements = 0, empty = 0;
+  for (fstl::size_t j = 0; j < umii.bucket_count(); ++j) empty += umii.bucket_size(j) == 0;
+  for (fstl::size_t j = 0; j < stats.histogram_size; ++j) {
+    buckets += stats.length_histogram[j];
+    elements += j * stats.length_histogram[j];
+  }
+  REQUIRE(stats.empty_buckets == empty);
+  REQUIRE(stats.length_histogram[0] == empty);
+  REQUIRE(buckets == umii.bucket_count());
+  REQUIRE(elements == umii.size());
+  REQUIRE(stats.uniformity > 0.5);
+  REQUIRE(stats.uniformity < 2);
+
+  fstl::unordered_map<int, int, one_bucket_hash<int>> clustered(1024);
+  for (int j = 0; j < 100; ++j) clustered[j] = j;
+  stats = clustered.stats();
+  REQUIRE(stats.max_length == 100);
+  REQUIRE(stats.length_histogram[stats.histogram_size - 1] == 1);
+  REQUIRE(stats.uniformity > 10);
+}
+#endif
+
 TEST_CASE("unordered_map::clear", "[modifiers]") {
   unordered_map<int, dummy> umid(2);
   umid[0] = dummy{0};
@@ -120,4 +273,251 @@ TEST_CASE("unordered_map::clear", "[modifiers]") {
   umid.clear();
   REQUIRE(umid.size() == 0);
   REQUIRE(destroy == 4);
-}
\ No newline at end of file
+}
+TEST_CASE("unordered_map::emplace", "[modifiers]") {
+  unordered_map<int, dummy> umid(4);
+  copy = move = 0;
+  auto [it, inserted] = umid.emplace(1, dummy{});
+  REQUIRE(inserted);
+  REQUIRE(it->first == 1);
+  REQUIRE(copy == 1);
+  REQUIRE(move == 0);
+
+  destroy = 0;
+  auto [it2, inserted2] = umid.emplace(1, dummy{});
+  REQUIRE(!inserted2);
+  REQUIRE(it2->first == 1);
+  REQUIRE(umid.size() == 1);
+  // The temporary and the rejected pair
+  REQUIRE(destroy == 2);
+}
+
+TEST_CASE("unordered_map::copy", "[ctor]") {
+  unordered_map<int, int> umii(4);
+  umii[1] = 10;
+  umii[2] = 20;
+  unordered_map<int, int> copied = umii;
+  copied[3] = 30;
+  REQUIRE(umii.size() == 2);
+  REQUIRE(copied.size() == 3);
+  REQUIRE(copied.at(2) == 20);
+
+  unordered_map<int, int> moved = std::move(copied);
+  REQUIRE(moved.size() == 3);
+  moved = umii;
+  REQUIRE(moved.size() == 2);
+  REQUIRE(moved.at(1) == 10);
+}
+
+TEST_CASE("unordered_map::use_after_move", "[ctor]") {
+  unordered_map<int, std::string> umis;
+  umis[1] = "one";
+  unordered_map<int, std::string> moved = std::move(umis);
+  umis.clear();
+  umis[2] = "two";
+  REQUIRE(umis.size() == 1);
+  REQUIRE(umis.count(1) == 0);
+  REQUIRE(umis.at(2) == "two");
+  moved = std::move(umis);
+  umis.emplace(3, "three");
+  REQUIRE(umis.size() == 1);
+  REQUIRE(moved.at(2) == "two");
+}
+
+TEST_CASE("unordered_map::insert", "[modifiers]") {
+  unordered_map<int, int> umii(4);
+  auto [it, inserted] = umii.insert({1, 10});
+  REQUIRE(inserted);
+  REQUIRE(it->second == 10);
+  auto [it2, inserted2] = umii.insert({1, 20});
+  REQUIRE(!inserted2);
+  REQUIRE(it2->second == 10);
+  REQUIRE(umii.size() == 1);
+}
+
+#if !TEST_STD_UM
+static int hash_calls = 0, compare_calls = 0;
+template <class T>
+struct counting_hash {
+  size_t operator()(const T &val) const { ++hash_calls; return fstl::hash<T>{}(val); }
+};
+template <class T>
+struct counting_equal {
+  bool operator()(const T &lhs, const T &rhs) const { ++compare_calls; return lhs == rhs; }
+};
+
+TEST_CASE("unordered_map::cached_hash", "[lookup]") {
+  fstl::unordered_map<int, int, counting_hash<int>, counting_equal<int>> umii(1);
+  hash_calls = compare_calls = 0;
+  for (int j = 0; j < 1000; ++j) {
+    umii[j] = j;
+  }
+  // Growing reuses the stored hashes, and distinct hashes never reach the comparator.
+  REQUIRE(hash_calls == 1000);
+  REQUIRE(compare_calls == 0);
+
+  for (int j = 1000; j < 2000; ++j) {
+    REQUIRE(umii.count(j) == 0);
+  }
+  REQUIRE(compare_calls == 0);
+  REQUIRE(umii.at(500) == 500);
+  REQUIRE(compare_calls == 1);
+
+  auto copied = umii;
+  umii.rehash(1 << 14);
+  REQUIRE(hash_calls == 2001);
+  REQUIRE(copied.at(7) == 7);
+}
+#endif
+
+#if !TEST_STD_UM
+TEST_CASE("unordered_map::transparent", "[lookup]") {
+  unordered_map<std::string, int> umsi;
+  umsi["a key that does not fit in the small string buffer"] = 1;
+  umsi[std::string("short")] = 2;
+  std::string_view view = "short";
+
+  REQUIRE(umsi.count(view) == 1);
+  REQUIRE(umsi.find("short")->second == 2);
+  REQUIRE(umsi.at("a key that does not fit in the small string buffer") == 1);
+  REQUIRE(umsi.find(std::string_view("missing")) == umsi.end());
+  REQUIRE_THROWS_AS(umsi.at("missing"), std::out_of_range);
+
+  umsi["new"] = 3;
+  REQUIRE(umsi.size() == 3);
+  REQUIRE(umsi.at(std::string("new")) == 3);
+
+  fstl::unordered_map<std::string, int, fstl::hash<std::string>, fstl::detail::equal_to<std::string>,
+                      fstl::detail::default_allocator<fstl::pair<const std::string, int>>,
+                      fstl::open_addressing> flat;
+  flat["short"] = 2;
+  REQUIRE(flat.count(view) == 1);
+  REQUIRE(flat.at("short") == 2);
+  REQUIRE(flat.find("missing") == flat.end());
+}
+#endif
+
+TEST_CASE("unordered_map::erase", "[modifiers]") {
+  unordered_map<int, dummy> umid(4);
+  for (int j = 0; j < 100; ++j) {
+    umid[j];
+  }
+  destroy = 0;
+  REQUIRE(umid.erase(42) == 1);
+  REQUIRE(umid.erase(42) == 0);
+  REQUIRE(destroy == 1);
+  REQUIRE(umid.size() == 99);
+  REQUIRE(umid.count(42) == 0);
+
+  // Erase everything odd while iterating.
+  for (auto it = umid.begin(); it != umid.end();) {
+    if (it->first % 2) {
+      it = umid.erase(it);
+    } else {
+      ++it;
+    }
+  }
+  REQUIRE(umid.size() == 49);
+  for (int j = 0; j < 100; ++j) {
+    REQUIRE(umid.count(j) == (j % 2 == 0 && j != 42 ? 1 : 0));
+  }
+}
+
+#if !TEST_STD_UM
+TEST_CASE("unordered_map::extract", "[modifiers]") {
+  unordered_map<int, dummy> src(4), dst(4);
+  src[1];
+  src[2];
+  auto *element = &src.at(1);
+
+  auto node = src.extract(1);
+  REQUIRE(node);
+  REQUIRE(node.key() == 1);
+  REQUIRE(src.size() == 1);
+  REQUIRE(!src.extract(5));
+
+  copy = move = destroy = 0;
+  node.key() = 3;
+  auto result = dst.insert(std::move(node));
+  REQUIRE(result.inserted);
+  REQUIRE(result.position->first == 3);
+  REQUIRE(!result.node);
+  // Relinked, not copied.
+  REQUIRE(&dst.at(3) == element);
+  REQUIRE(copy + move + destroy == 0);
+
+  dst[2];
+  auto again = dst.insert(src.extract(2));
+  REQUIRE(!again.inserted);
+  REQUIRE(again.node.key() == 2);
+  REQUIRE(again.position->first == 2);
+  REQUIRE(src.size() == 0);
+
+  // A handle keeps its map's allocator, here with a pool of its own, alive.
+  using pair_type = fstl::pair<const int, std::string>;
+  using pooled = fstl::unordered_map<int, std::string, fstl::hash<int>, fstl::detail::equal_to<int>,
+                                     fstl::pool_allocator<pair_type>>;
+  auto *temp = new pooled(2);
+  (*temp)[7] = std::string(100, 'x');
+  auto orphan = temp->extract(7);
+  delete temp;
+  REQUIRE(orphan.mapped().size() == 100);
+}
+
+TEST_CASE("unordered_map::merge", "[modifiers]") {
+  unordered_map<int, int> a(4), b(4);
+  for (int j = 0; j < 100; ++j) {
+    a[j] = j;
+  }
+  for (int j = 50; j < 150; ++j) {
+    b[j] = -j;
+  }
+  a.merge(b);
+  REQUIRE(a.size() == 150);
+  // Keys already present stay behind.
+  REQUIRE(b.size() == 50);
+  REQUIRE(a.at(60) == 60);
+  REQUIRE(b.at(60) == -60);
+  REQUIRE(a.at(120) == -120);
+
+  fstl::node_pool pool(64);
+  using pair_type = fstl::pair<const int, int>;
+  using pooled = fstl::unordered_map<int, int, fstl::hash<int>, fstl::detail::equal_to<int>,
+                                     fstl::pool_allocator<pair_type>>;
+  pooled p1(4), p2(4, {}, {}, fstl::pool_allocator<pair_type>(pool));
+  p1[1] = 1;
+  p2[2] = 2;
+  p2.merge(p1);
+  REQUIRE(p1.size() == 0);
+  REQUIRE(p2.at(1) == 1);
+  p1.insert(p2.extract(2));
+  REQUIRE(p1.at(2) == 2);
+}
+#endif
+
+#if !TEST_STD_UM
+TEST_CASE("unordered_map::find_batch", "[lookup]") {
+  unordered_map<int, int> umii(4);
+  for (int j = 0; j < 1000; j += 2) {
+    umii[j] = -j;
+  }
+  std::vector<int> keys;
+  for (int j = 0; j < 100; ++j) {
+    keys.push_back(j * 7);
+  }
+  std::vector<fstl::pair<const int, int> *> found(keys.size());
+  umii.find_batch(keys.data(), keys.size(), found.data());
+  std::unique_ptr<bool[]> present(new bool[keys.size()]);
+  umii.contains_batch(keys.data(), keys.size(), present.get());
+  for (size_t j = 0; j < keys.size(); ++j) {
+    bool even = keys[j] % 2 == 0;
+    REQUIRE(present[j] == even);
+    REQUIRE((found[j] != nullptr) == even);
+    if (even) REQUIRE(found[j]->second == -keys[j]);
+  }
+
+  unordered_map<int, int> empty(4);
+  empty.find_batch(keys.data(), keys.size(), found.data());
+  REQUIRE(found[0] == nullptr);
+}
+#endif
@@ -2,6 +2,8 @@
 #include <stdexcept>
 #include <set>
 #include <iterator>
+#include <sstream>
+#include <string>
 #include <type_traits>
 
 #define TEST_STD_VEC 0
@@ -68,6 +70,18 @@ TEST_CASE("vector::move", "[ctor]") {
   REQUIRE(moved[99] == 10);
 }
 
+TEST_CASE("vector::use_after_move", "[ctor]") {
+  vector<std::string> orig(3, "x");
+  vector<std::string> moved = std::move(orig);
+  orig.push_back("y");
+  REQUIRE(orig.size() == 1);
+  REQUIRE(orig[0] == "y");
+  moved = std::move(orig);
+  orig.resize(2);
+  REQUIRE(orig.size() == 2);
+  REQUIRE(moved.size() == 1);
+}
+
 TEST_CASE("vector::vector(It, It)", "[ctor]") {
   vector<int> vi1;
   vi1.push_back(0);
@@ -98,6 +112,10 @@ TEST_CASE("vector::operator[]", "[elem_access]") {
   REQUIRE(vi[0] == 10);
   vi[0] = 20;
   REQUIRE(vi[0] == 20);
+
+#if defined(FSTL_HARDENED) && !TEST_STD_VEC
+  REQUIRE_THROWS_AS(vi[100], std::out_of_range);
+#endif
 }
 
 TEST_CASE("vector::front_back", "[elem_access]") {
@@ -189,6 +207,14 @@ TEST_CASE("vector::emplace", "[modifiers]") {
   REQUIRE(vd[0].b == 2.f);
   REQUIRE(vd[50].a == 100);
   REQUIRE(vd[102].b == 20.f);
+
+  // Arguments referring to elements that are about to move
+  vector<int> vi{1, 2, 3};
+  vi.shrink_to_fit();
+  vi.emplace_back(vi[0]);
+  vi.emplace(vi.begin(), vi[2]);
+  vi.emplace(vi.begin() + 1, vi[4]);
+  REQUIRE(vi == vector<int>{3, 1, 1, 2, 3, 1});
 }
 
 TEST_CASE("vector::erase", "[modifiers]") {
@@ -217,6 +243,50 @@ TEST_CASE("vector::erase", "[modifiers]") {
 }
 
 static int copy = 0, move = 0;
+TEST_CASE("vector::insert_range", "[modifiers]") {
+  vector<int> vi{0, 1, 5, 6};
+
+  // Contiguous source
+  int arr[] = {2, 3};
+  auto it = vi.insert(vi.begin() + 2, arr, arr + 2);
+  REQUIRE(*it == 2);
+  REQUIRE(vi.size() == 6);
+
+  // Forward (non random access) source
+  std::set<int> si{4};
+  it = vi.insert(vi.begin() + 4, si.begin(), si.end());
+  REQUIRE(*it == 4);
+
+  // Single pass source
+  std::istringstream is("7 8 9");
+  vi.insert(vi.end(), std::istream_iterator<int>(is), std::istream_iterator<int>());
+  REQUIRE(vi.size() == 10);
+  for (int j = 0; j < 10; ++j) REQUIRE(vi[j] == j);
+
+  // Inserting a range of the vector into itself
+  vi.insert(vi.begin(), vi.begin() + 8, vi.end());
+  REQUIRE(vi.size() == 12);
+  REQUIRE(vi[0] == 8);
+  REQUIRE(vi[1] == 9);
+  REQUIRE(vi[2] == 0);
+
+  // The tail is shifted once, not once per inserted element
+  struct dummy
+  {
+    dummy() = default;
+    dummy(const dummy &) { ++copy; }
+    dummy(dummy &&) noexcept { ++move; }
+  };
+  vector<dummy> vd(10);
+  vd.reserve(20);
+  dummy src[5];
+  copy = move = 0;
+  vd.insert(vd.begin(), src, src + 5);
+  REQUIRE(vd.size() == 15);
+  REQUIRE(copy == 5);
+  REQUIRE(move == 10);
+}
+
 TEST_CASE("vector::push_back", "[modifiers]") {
   copy = move = 0;
   struct dummy
@@ -258,16 +328,11 @@ TEST_CASE("vector::emplace_back", "[modifiers]") {
   REQUIRE(v.size() == 2);
   REQUIRE(copy == 0);
 
-  // behavior is slightly different here, we can't emplace in fstl.
-#if TEST_STD_VEC
   REQUIRE(move == 0);
   v.emplace_back(2);
+  // Only the existing elements are moved when growing.
   REQUIRE(move == 2);
-#else
-  REQUIRE(move == 2);
-  v.emplace_back(2);
-  REQUIRE(move == 2 + 2 + 1);
-#endif
+  REQUIRE(copy == 0);
 }
 
 TEST_CASE("vector::pop_back", "[modifiers]") {
@@ -452,4 +517,72 @@ TEST_CASE("vector::traits", "[traits]") {
   REQUIRE(std::is_same_v<std::iterator_traits<vector<int>::const_reverse_iterator>::value_type, int>);
   REQUIRE(std::is_same_v<std::iterator_traits<vector<int>::const_reverse_iterator>::pointer, const int *>);
   REQUIRE(std::is_same_v<std::iterator_traits<vector<int>::const_reverse_iterator>::reference, const int &>);
-}
\ No newline at end of file
+}
+TEST_CASE("vector::relocation", "[modifiers]") {
+  // Trivially relocatable elements are moved with memmove.
+  vector<int> vi;
+  for (int j = 0; j < 100; ++j) vi.insert(vi.begin(), j);
+  REQUIRE(vi.size() == 100);
+  REQUIRE(vi[0] == 99);
+  REQUIRE(vi[99] == 0);
+  vi.erase(vi.begin() + 10, vi.begin() + 90);
+  REQUIRE(vi.size() == 20);
+  REQUIRE(vi[9] == 90);
+  REQUIRE(vi[10] == 9);
+
+  // Inserting an element of the vector itself while it grows.
+  vector<int> vi2{1, 2, 3};
+  vi2.shrink_to_fit();
+  vi2.push_back(vi2[0]);
+  vi2.insert(vi2.begin(), vi2[2]);
+  REQUIRE(vi2.size() == 5);
+  REQUIRE(vi2[0] == 3);
+  REQUIRE(vi2[4] == 1);
+
+  copy = move = 0;
+  struct dummy
+  {
+    int x = 0;
+    dummy() = default;
+    explicit dummy(int x) : x(x) {}
+    dummy(const dummy &o) : x(o.x) { ++copy; }
+    dummy(dummy &&o) noexcept : x(o.x) { ++move; }
+  };
+  vector<dummy> vd;
+  vd.reserve(3);
+  vd.emplace_back(1);
+  vd.emplace_back(3);
+  move = 0;
+  vd.insert(vd.begin() + 1, dummy{2});
+  REQUIRE(vd[0].x == 1);
+  REQUIRE(vd[1].x == 2);
+  REQUIRE(vd[2].x == 3);
+  // One move for the shifted tail and one for the inserted value.
+  REQUIRE(move == 2);
+  REQUIRE(copy == 0);
+}
+
+template <class T>
+struct tagged_allocator {
+  using value_type = T;
+  template <class U> struct rebind { using other = tagged_allocator<U>; };
+  int tag = 0;
+  T *allocate(std::size_t n) { return static_cast<T *>(::operator new(n * sizeof(T))); }
+  void deallocate(T *p, std::size_t n) { ::operator delete(p, n * sizeof(T)); }
+};
+
+TEST_CASE("vector::allocator_adapter", "[allocator]") {
+#if !TEST_STD_VEC
+  // Stateless allocators share a single adapter...
+  vector<int> vi1, vi2;
+  REQUIRE(vi1.get_allocator() == vi2.get_allocator());
+  vector<int> vi3 = vi1;
+  REQUIRE(vi3.get_allocator() == vi1.get_allocator());
+
+  // ...stateful ones get their own.
+  fstl::vector<int, tagged_allocator<int>> vt1(2, 1, tagged_allocator<int>{1});
+  fstl::vector<int, tagged_allocator<int>> vt2 = vt1;
+  REQUIRE(vt1.get_allocator() != vt2.get_allocator());
+  REQUIRE(vt2[1] == 1);
+#endif
+}